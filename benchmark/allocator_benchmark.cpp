@@ -0,0 +1,61 @@
+#include "tasks/Allocator.h"
+#include "tasks/ArenaMemoryPool.h"
+#include "tasks/SlabMemoryPool.h"
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Measures allocation throughput of the memory pool kinds when many threads allocate task sized
+// blocks concurrently, as producers do in try_push.
+// usage: allocator_benchmark [threads] [allocations per thread]
+
+namespace
+{
+    constexpr std::size_t poolSize = std::size_t(1) << 27;
+
+    template <typename TPool>
+    double run(TPool& pool, int threadCount, int allocations)
+    {
+        pool.reset();
+        std::atomic<bool> start{false};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; t++)
+        {
+            threads.emplace_back([&]() {
+                while (!start)
+                    std::this_thread::yield();
+                for (int i = 0; i < allocations; i++)
+                {
+                    // promise shared state and task sized blocks, released out of order
+                    char* p = pool.template allocate<8>(64);
+                    char* q = pool.template allocate<8>(48);
+                    pool.deallocate(p, 64);
+                    (void)q;
+                }
+            });
+        }
+        const auto t0 = std::chrono::steady_clock::now();
+        start         = true;
+        for (auto& t : threads)
+            t.join();
+        const auto t1 = std::chrono::steady_clock::now();
+        return 2.0 * threadCount * allocations / std::chrono::duration<double>(t1 - t0).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int threads     = argc > 1 ? std::atoi(argv[1])
+                                     : int(std::thread::hardware_concurrency());
+    const int allocations = argc > 2 ? std::atoi(argv[2]) : 100000;
+    static tasks::memory::MemoryPool<poolSize> shared;
+    static tasks::memory::ArenaMemoryPool<poolSize> arena;
+    static tasks::memory::SlabMemoryPool<poolSize> slab;
+
+    std::cout << threads << " threads, " << allocations << " allocation pairs per thread\n";
+    std::cout << "MemoryPool:      " << run(shared, threads, allocations) << " allocations/s\n";
+    std::cout << "ArenaMemoryPool: " << run(arena, threads, allocations) << " allocations/s\n";
+    std::cout << "SlabMemoryPool:  " << run(slab, threads, allocations) << " allocations/s\n";
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include "tasks/Queue.h"
+#include "tasks/Scheduler.h"
+#include "tasks/SlabMemoryPool.h"
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Measures completion throughput: workers run tiny tasks whose shared states were allocated back to
+// back, so with a plain pool neighbouring states share cache lines and workers completing adjacent
+// tasks invalidate each other's lines. The padded pool gives every allocation its own lines.
+// usage: completion_benchmark [threads] [tasks]
+
+namespace
+{
+    constexpr int64_t batch = 256;
+
+    template <template <std::size_t, std::size_t> class TPool>
+    using TaskQueue = tasks::threadsafe::
+        Queue<int, 1024, std::size_t(1) << 22, tasks::threadsafe::SequencedRing, 48, TPool>;
+
+    template <template <std::size_t, std::size_t> class TPool>
+    double run(int threadCount, int taskCount)
+    {
+        TaskQueue<TPool> queue;
+        tasks::Scheduler<TaskQueue<TPool>> scheduler(queue, threadCount);
+        std::vector<std::future<int>> futures;
+        futures.reserve(batch);
+
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int done = 0; done < taskCount; done += int(batch))
+        {
+            for (int64_t i = 0; i < batch; i++)
+                futures.emplace_back(queue.try_push([i]() { return int(i); }));
+            for (auto& f : futures)
+                f.get();
+            futures.clear();
+        }
+        const auto t1 = std::chrono::steady_clock::now();
+        return taskCount / std::chrono::duration<double>(t1 - t0).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int threads = argc > 1 ? std::atoi(argv[1]) : int(std::thread::hardware_concurrency());
+    const int tasks   = argc > 2 ? std::atoi(argv[2]) : 200000;
+
+    std::cout << threads << " threads, " << tasks << " tasks\n";
+    // the slab pool recycles shared states, so the pool is never exhausted
+    std::cout << "SlabMemoryPool:                  "
+              << run<tasks::memory::SlabMemoryPool>(threads, tasks) << " completions/s\n";
+    std::cout << "CacheLinePadded<SlabMemoryPool>: "
+              << run<tasks::memory::CacheLinePadded<tasks::memory::SlabMemoryPool>::type>(threads,
+                                                                                          tasks)
+              << " completions/s\n";
+    return 0;
+}
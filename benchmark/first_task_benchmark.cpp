@@ -0,0 +1,81 @@
+#include "tasks/DynamicMemoryPool.h"
+#include "tasks/Queue.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// Measures what a cold memory pool costs the first tasks of a queue: the latency of the very first
+// submit/run/get round trip and the time to run the first batch of tasks, on a freshly created
+// queue each sample. Untouched pages fault in on first use, a LockedMemoryPool has paid for that
+// at construction. The queue's MemoryPool lives in a heap block, which the C library may hand
+// back already warm from the previous sample.
+// usage: first_task_benchmark [samples] [tasks]
+
+namespace
+{
+    constexpr std::size_t poolSize = std::size_t(1) << 22;
+    using clock                    = std::chrono::steady_clock;
+
+    template <template <std::size_t, std::size_t> class TPool>
+    using TaskQueue = tasks::threadsafe::
+        Queue<int, 1024, poolSize, tasks::threadsafe::SequencedRing, 48, TPool>;
+
+    template <template <std::size_t, std::size_t> class TPool>
+    void run(const char* name, int samples, int taskCount)
+    {
+        std::vector<double> first;
+        std::vector<double> batch;
+        for (int s = 0; s < samples; s++)
+        {
+            TaskQueue<TPool> queue;
+
+            auto t0 = clock::now();
+            auto f  = queue.try_push([]() { return 1; });
+            queue.try_call_next();
+            f.get();
+            auto t1 = clock::now();
+            first.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+
+            // tasks too large to be stored inline walk through fresh pages of the pool
+            std::array<char, 240> payload{};
+            int sum = 0;
+            t0      = clock::now();
+            for (int i = 0; i < taskCount; i++)
+            {
+                payload[0] = char(i);
+                queue.try_post([payload, &sum]() { sum += payload[0]; });
+                queue.try_call_next();
+            }
+            t1 = clock::now();
+            batch.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+            if (sum == -1)
+                std::cout << sum;
+        }
+        std::sort(first.begin(), first.end());
+        std::sort(batch.begin(), batch.end());
+        std::cout << name << "\tfirst task median " << first[first.size() / 2] << " us\tfirst "
+                  << taskCount << " tasks median " << batch[batch.size() / 2] << " us\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int samples = argc > 1 ? std::atoi(argv[1]) : 50;
+    const int tasks   = argc > 2 ? std::atoi(argv[2]) : 10000;
+
+    std::cout << "page size " << tasks::memory::pageSize() << ", huge page size "
+              << tasks::memory::hugePageSize() << "\n";
+    {
+        tasks::memory::LockedMemoryPool<poolSize> probe;
+        const auto& mapping = probe.mapping();
+        std::cout << "LockedMemoryPool got: huge pages " << mapping.hugePages << ", THP "
+                  << mapping.transparentHugePages << ", populated " << mapping.populated
+                  << ", locked " << mapping.locked << "\n";
+    }
+    run<tasks::memory::MemoryPool>("MemoryPool       ", samples, tasks);
+    run<tasks::memory::DynamicMemoryPool>("DynamicMemoryPool", samples, tasks);
+    run<tasks::memory::LockedMemoryPool>("LockedMemoryPool ", samples, tasks);
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include "tasks/Future.h"
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Measures a ping-pong hand-off between two threads, each round trip going through a fresh
+// promise/future pair in both directions: std::promise (mutex and condition variable in the
+// shared state) against tasks::Promise (one state word, spin then park).
+// usage: future_benchmark [round trips]
+
+namespace
+{
+    template <template <typename> class TPromise>
+    double run(int roundTrips)
+    {
+        std::vector<TPromise<int>> pings{std::size_t(roundTrips)};
+        std::vector<TPromise<int>> pongs{std::size_t(roundTrips)};
+        std::vector<decltype(pings[0].get_future())> pingFutures;
+        std::vector<decltype(pongs[0].get_future())> pongFutures;
+        for (int i = 0; i < roundTrips; i++)
+        {
+            pingFutures.emplace_back(pings[std::size_t(i)].get_future());
+            pongFutures.emplace_back(pongs[std::size_t(i)].get_future());
+        }
+
+        std::thread responder([&]() {
+            for (int i = 0; i < roundTrips; i++)
+                pongs[std::size_t(i)].set_value(pingFutures[std::size_t(i)].get() + 1);
+        });
+        int64_t sum   = 0;
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < roundTrips; i++)
+        {
+            pings[std::size_t(i)].set_value(i);
+            sum += pongFutures[std::size_t(i)].get();
+        }
+        const auto t1 = std::chrono::steady_clock::now();
+        responder.join();
+        if (sum < 0)
+            std::cout << sum;
+        return std::chrono::duration<double, std::nano>(t1 - t0).count() / roundTrips;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int roundTrips = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    std::cout << roundTrips << " round trips\n";
+    std::cout << "std::promise:   " << run<std::promise>(roundTrips) << " ns/round trip\n";
+    std::cout << "tasks::Promise: " << run<tasks::Promise>(roundTrips) << " ns/round trip\n";
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include "tasks/Queue.h"
+#include "tasks/Scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Measures the wake-up latency of an idle Scheduler for each IdlePolicy: the time between posting a
+// task to a queue that has been empty for a while and the task starting to run.
+// usage: idle_benchmark [threads] [samples]
+
+namespace
+{
+    using TaskQueue =
+        tasks::threadsafe::Queue<void, 1024, 1 << 16, tasks::threadsafe::SequencedRing>;
+    using clock     = std::chrono::steady_clock;
+
+    void run(TaskQueue& queue,
+             const char* name,
+             tasks::IdlePolicy policy,
+             int threadCount,
+             int samples)
+    {
+        using namespace std::chrono_literals;
+        tasks::SchedulerConfig config;
+        config.threadCount = threadCount;
+        config.idlePolicy  = policy;
+        tasks::Scheduler<TaskQueue> scheduler(queue, config);
+
+        std::vector<double> latencies;
+        for (int i = 0; i < samples; i++)
+        {
+            std::this_thread::sleep_for(2ms);
+            std::atomic<clock::rep> started{0};
+            const auto t0 = clock::now();
+            queue.try_post([&started]() { started = clock::now().time_since_epoch().count(); });
+            while (started == 0)
+                tasks::cpuRelax();
+            const auto t1 = clock::time_point(clock::duration(started.load()));
+            latencies.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+        }
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << name << "\tmedian " << latencies[latencies.size() / 2] << " us\tp99 "
+                  << latencies[latencies.size() * 99 / 100] << " us\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int threads = argc > 1 ? std::atoi(argv[1]) : 2;
+    const int samples = argc > 2 ? std::atoi(argv[2]) : 200;
+    static TaskQueue queue;
+
+    run(queue, "Spin        ", tasks::IdlePolicy::Spin, threads, samples);
+    run(queue, "Yield       ", tasks::IdlePolicy::Yield, threads, samples);
+    run(queue, "SpinThenPark", tasks::IdlePolicy::SpinThenPark, threads, samples);
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "tasks/Queue.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Measures push/call throughput of threadsafe::Queue for each ring layout.
+// usage: queue_benchmark [producers] [consumers] [total tasks]
+
+namespace
+{
+    template <template <typename, int64_t> class TRing>
+    double run(int producerCount, int consumerCount, int taskCount)
+    {
+        using TaskQueue = tasks::threadsafe::Queue<void, 4096, 1 << 26, TRing>;
+        static TaskQueue queue;
+
+        const int tasksPerProducer = taskCount / producerCount;
+        const int64_t total        = int64_t(producerCount) * tasksPerProducer;
+        std::atomic<int64_t> executed{0};
+        std::atomic<bool> start{false};
+
+        std::vector<std::thread> threads;
+        for (int c = 0; c < consumerCount; c++)
+        {
+            threads.emplace_back([&]() {
+                while (!start)
+                    std::this_thread::yield();
+                while (executed.load(std::memory_order_relaxed) < total)
+                {
+                    if (queue.try_call_next())
+                        executed.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+        }
+        for (int p = 0; p < producerCount; p++)
+        {
+            threads.emplace_back([&]() {
+                while (!start)
+                    std::this_thread::yield();
+                for (int i = 0; i < tasksPerProducer; i++)
+                {
+                    // keep the ring from overflowing, try_push asserts on a full buffer
+                    while (queue.size() > 2048)
+                        std::this_thread::yield();
+                    queue.try_push([]() {});
+                }
+            });
+        }
+
+        const auto t0 = std::chrono::steady_clock::now();
+        start         = true;
+        for (auto& t : threads)
+            t.join();
+        const auto t1 = std::chrono::steady_clock::now();
+        return double(total) / std::chrono::duration<double>(t1 - t0).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int hardware  = std::max(2u, std::thread::hardware_concurrency());
+    const int producers = argc > 1 ? std::atoi(argv[1]) : hardware / 2;
+    const int consumers = argc > 2 ? std::atoi(argv[2]) : hardware / 2;
+    const int count     = argc > 3 ? std::atoi(argv[3]) : 100000;
+
+    std::cout << producers << " producers, " << consumers << " consumers, " << count
+              << " tasks\n";
+    std::cout << "SharedCounterRing: "
+              << run<tasks::threadsafe::SharedCounterRing>(producers, consumers, count)
+              << " tasks/s\n";
+    std::cout << "SequencedRing:     "
+              << run<tasks::threadsafe::SequencedRing>(producers, consumers, count)
+              << " tasks/s\n";
+    return 0;
+}
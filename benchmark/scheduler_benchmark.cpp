@@ -0,0 +1,76 @@
+#include "tasks/Queue.h"
+#include "tasks/Scheduler.h"
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+// Measures how a recursive fork workload scales with the number of workers, once with tasks
+// spawned onto the workers' deques and once with every task going through the shared queue.
+// usage: scheduler_benchmark [tree depth]
+
+namespace
+{
+    using TaskQueue =
+        tasks::threadsafe::Queue<void, 1 << 18, 1 << 16, tasks::threadsafe::SequencedRing>;
+    using TaskScheduler = tasks::Scheduler<TaskQueue>;
+
+    void work()
+    {
+        volatile int x = 0;
+        for (int i = 0; i < 200; i++)
+            x = x + i;
+    }
+    void spawnTree(TaskScheduler& scheduler, tasks::CompletionCounter& counter, int depth)
+    {
+        work();
+        if (depth == 0)
+            return;
+        for (int i = 0; i < 2; i++)
+            scheduler.spawn(counter, [&scheduler, &counter, depth]() {
+                spawnTree(scheduler, counter, depth - 1);
+            });
+    }
+    void postTree(TaskQueue& queue, tasks::CompletionCounter& counter, int depth)
+    {
+        work();
+        if (depth == 0)
+            return;
+        for (int i = 0; i < 2; i++)
+            queue.try_post(counter,
+                           [&queue, &counter, depth]() { postTree(queue, counter, depth - 1); });
+    }
+
+    template <typename TFunc>
+    double measure(TaskQueue& queue, int threadCount, TFunc&& root)
+    {
+        TaskScheduler scheduler(queue, threadCount);
+        tasks::CompletionCounter counter;
+        const auto t0 = std::chrono::steady_clock::now();
+        root(scheduler, counter);
+        counter.wait();
+        const auto t1 = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(t1 - t0).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int depth    = argc > 1 ? std::atoi(argv[1]) : 16;
+    const int maxCores = std::max(1u, std::thread::hardware_concurrency());
+    static TaskQueue queue;
+
+    std::cout << "threads\tstealing (ms)\tshared queue (ms)\n";
+    for (int threads = 1; threads <= maxCores; threads++)
+    {
+        const auto stealing = measure(queue, threads, [depth](auto& scheduler, auto& counter) {
+            scheduler.spawn(counter, [&scheduler, &counter, depth]() {
+                spawnTree(scheduler, counter, depth);
+            });
+        });
+        const auto shared = measure(queue, threads, [depth](auto&, auto& counter) {
+            queue.try_post(counter, [&counter, depth]() { postTree(queue, counter, depth); });
+        });
+        std::cout << threads << "\t" << stealing << "\t" << shared << "\n";
+    }
+    return 0;
+}
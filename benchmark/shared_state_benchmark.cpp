@@ -0,0 +1,63 @@
+#include "tasks/Queue.h"
+#include "tasks/RecyclingMemoryPool.h"
+#include "tasks/SlabMemoryPool.h"
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// Measures the submit/run/get round trip of try_push, which allocates a promise/future shared
+// state per task, with the shared states coming fresh from a bump pool, from the slab pool's size
+// classes, or from the recycling free list in front of the bump pool.
+// usage: shared_state_benchmark [tasks] [in flight]
+
+namespace
+{
+    // large enough for the bump pool to serve every task without reclaiming anything
+    constexpr std::size_t poolSize = std::size_t(1) << 26;
+
+    template <template <std::size_t, std::size_t> class TPool>
+    using TaskQueue =
+        tasks::threadsafe::Queue<int, 1024, poolSize, tasks::threadsafe::SequencedRing, 48, TPool>;
+
+    template <template <std::size_t, std::size_t> class TPool>
+    double run(int taskCount, int inFlight)
+    {
+        TaskQueue<TPool> queue;
+        std::vector<std::future<int>> futures;
+        futures.reserve(std::size_t(inFlight));
+        int64_t sum = 0;
+
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int done = 0; done < taskCount; done += inFlight)
+        {
+            for (int i = 0; i < inFlight; i++)
+                futures.emplace_back(queue.try_push([i]() { return i; }));
+            while (queue.try_call_next())
+            {
+            }
+            for (auto& f : futures)
+                sum += f.get();
+            futures.clear();
+        }
+        const auto t1 = std::chrono::steady_clock::now();
+        if (sum < 0)
+            std::cout << sum;
+        return std::chrono::duration<double, std::nano>(t1 - t0).count() / taskCount;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int tasks    = argc > 1 ? std::atoi(argv[1]) : 200000;
+    const int inFlight = argc > 2 ? std::atoi(argv[2]) : 16;
+
+    std::cout << tasks << " tasks, " << inFlight << " in flight\n";
+    std::cout << "MemoryPool:            " << run<tasks::memory::MemoryPool>(tasks, inFlight)
+              << " ns/task\n";
+    std::cout << "SlabMemoryPool:        " << run<tasks::memory::SlabMemoryPool>(tasks, inFlight)
+              << " ns/task\n";
+    std::cout << "Recycling<MemoryPool>: "
+              << run<tasks::memory::Recycling<tasks::memory::MemoryPool>::type>(tasks, inFlight)
+              << " ns/task\n";
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include "tasks/Queue.h"
+#include "tasks/Scheduler.h"
+#include "tasks/TaskGraph.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+// Measures repeated runs of the same layered graph: every node of a layer depends on every node of
+// the previous layer, so each run goes through width * width * (layers - 1) counter decrements.
+// usage: task_graph_benchmark [layers] [width] [runs]
+
+int main(int argc, char** argv)
+{
+    const int layers = argc > 1 ? std::atoi(argv[1]) : 16;
+    const int width  = argc > 2 ? std::atoi(argv[2]) : 8;
+    const int runs   = argc > 3 ? std::atoi(argv[3]) : 2000;
+
+    using TaskQueue = tasks::threadsafe::Queue<void, 1024, 1 << 20>;
+    TaskQueue queue;
+    tasks::Scheduler<TaskQueue> scheduler(queue);
+
+    std::atomic<int64_t> sum{0};
+    tasks::TaskGraph graph;
+    graph.reserve(std::size_t(layers * width));
+    for (int layer = 0; layer < layers; layer++)
+    {
+        for (int i = 0; i < width; i++)
+        {
+            const auto id =
+                graph.add_node([&sum, i]() { sum.fetch_add(i, std::memory_order_relaxed); });
+            if (layer == 0)
+                continue;
+            for (int j = 0; j < width; j++)
+                graph.add_edge(id - std::size_t(i) - std::size_t(width) + std::size_t(j), id);
+        }
+    }
+
+    graph.run_and_wait(scheduler);
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int run = 0; run < runs; run++)
+        graph.run_and_wait(scheduler);
+    const auto t1 = std::chrono::steady_clock::now();
+    if (sum < 0)
+        std::cout << sum;
+
+    const auto ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    std::cout << layers << " layers of " << width << " nodes, " << runs << " runs\n";
+    std::cout << "run:  " << ns / runs << " ns\n";
+    std::cout << "node: " << ns / runs / (layers * width) << " ns\n";
+    return 0;
+}
@@ -1,39 +1,37 @@
+#include "tasks/Future.h"
 #include "tasks/Queue.h"
 #include "tasks/Scheduler.h"
-#include <cassert>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 int main()
 {
-    using namespace std::chrono_literals;
     using TaskQueue = tasks::threadsafe::Queue<int, 512, 65536>;
     TaskQueue queue;
     tasks::Scheduler<TaskQueue> scheduler(queue);
 
-    const int N = 256;
+    const int N      = 256;
+    const int Groups = 8;
     std::atomic<int> result{0};
-    std::mutex mtx; // in order to emplace futures safely
-    std::vector<std::future<int>> futures;
-    futures.reserve(N);
-    for (size_t i = 0; i < N; i++)
+    // every submitting thread fills its own slot, no lock needed
+    std::vector<tasks::Future<std::vector<tasks::Future<int>>>> groups(Groups);
+    std::vector<std::thread> threads;
+    for (int g = 0; g < Groups; g++)
     {
         // example passing a lambda from multiple threads
-        std::thread([&futures, &mtx, &queue, &result]() {
-            auto f = queue.try_push([&result]() { return ++result; });
-            assert(f.valid());
-            std::lock_guard<std::mutex> lk(mtx);
-            futures.emplace_back(std::move(f));
-        })
-            .detach();
+        threads.emplace_back([&scheduler, &result, &group = groups[g]]() {
+            std::vector<tasks::Future<int>> futures;
+            for (int i = 0; i < N / Groups; i++)
+                futures.emplace_back(scheduler.async([&result]() { return ++result; }));
+            group = tasks::when_all(futures.begin(), futures.end());
+        });
     }
+    for (auto& thread : threads)
+        thread.join();
 
-    for (auto& f : futures)
-    {
-        if (f.valid())
-        {
-            f.wait();
-        }
-    }
+    // one wake-up for the whole batch
+    tasks::when_all(groups.begin(), groups.end()).wait();
 
     if (result == N)
     {
@@ -1,3 +1,4 @@
+#include "tasks/CompletionCounter.h"
 #include "tasks/Queue.h"
 #include "tasks/Scheduler.h"
 #include <cassert>
@@ -22,17 +23,14 @@ int main()
 
     const int N = 256;
     Op op;
-    std::vector<std::future<void>> futures;
-    for (size_t i = 0; i < N; i++)
-    {
-        futures.emplace_back(queue.try_push(&Op::sum, op, i, i * 2));
-        assert (futures.back().valid());
-    }
+    tasks::CompletionCounter counter;
+    // fan out all tasks at once, reserving their ring slots in a single step
+    const bool posted =
+        queue.try_post_n(counter, N, [&op](int64_t i) { op.sum(int(i), int(i * 2)); });
+    assert(posted);
+    (void)posted;
 
-    for (auto& f : futures)
-    {
-        f.wait();
-    }
+    counter.wait();
 
     int expected = 0;
     for (size_t i = 0; i < N; i++)
@@ -31,6 +31,7 @@
 #include <cassert>
 #include <cstddef>
 #include <cstring>
+#include <new>
 #include <utility>
 
 namespace tasks
@@ -39,10 +40,62 @@ namespace tasks
     {
         template <std::size_t N, std::size_t alignment = alignof(std::max_align_t)>
         class MemoryPool;
-        template <class T, std::size_t N, std::size_t Align = alignof(std::max_align_t)>
+        template <class T,
+                  std::size_t N,
+                  std::size_t Align                                  = alignof(std::max_align_t),
+                  template <std::size_t, std::size_t> class TPool = MemoryPool>
         class Allocator;
-        template <class T, std::size_t N, std::size_t Align = alignof(std::max_align_t)>
+        template <class T,
+                  std::size_t N,
+                  std::size_t Align                                  = alignof(std::max_align_t),
+                  template <std::size_t, std::size_t> class TPool = MemoryPool>
         class AllocatorWithInternalMemory;
+
+        // Pools support alignments up to a page.
+        constexpr std::size_t cache_line_size    = 64;
+        constexpr std::size_t max_pool_alignment = 4096;
+
+        // Pool kind adaptor rounding every allocation up to whole cache lines, so blocks of
+        // different tasks never share a line, e.g. Queue<..., CacheLinePadded<MemoryPool>::type>.
+        template <template <std::size_t, std::size_t> class TPool>
+        struct CacheLinePadded
+        {
+            template <std::size_t N, std::size_t alignment>
+            using type = TPool<N, (alignment > cache_line_size ? alignment : cache_line_size)>;
+        };
+
+        namespace detail
+        {
+            // Pools are either TPool<N, alignment> or expose their alignment as pool_alignment.
+            template <typename TMemoryPool>
+            struct PoolAlignment
+            {
+                static constexpr std::size_t value = TMemoryPool::pool_alignment;
+            };
+            template <template <std::size_t, std::size_t> class TPool, std::size_t N, std::size_t A>
+            struct PoolAlignment<TPool<N, A>>
+            {
+                static constexpr std::size_t value = A;
+            };
+
+            // Heap fallback of an exhausted pool, honouring the pool alignment.
+            template <std::size_t alignment>
+            char* allocateFromHeap(std::size_t n)
+            {
+                if constexpr (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+                    return static_cast<char*>(::operator new(n, std::align_val_t(alignment)));
+                else
+                    return static_cast<char*>(::operator new(n));
+            }
+            template <std::size_t alignment>
+            void deallocateToHeap(char* p) noexcept
+            {
+                if constexpr (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+                    ::operator delete(p, std::align_val_t(alignment));
+                else
+                    ::operator delete(p);
+            }
+        }
     }
 }
 
@@ -68,8 +121,12 @@ public:
         m_ptr = nullptr;
     }
     MemoryPool() noexcept
-    : m_ptr(m_buf)
     {
+        static_assert((alignment & (alignment - 1)) == 0, "alignment must be a power of two");
+        static_assert(alignment <= max_pool_alignment, "alignment is larger than a page");
+        // set here rather than in the initializer list, GCC reads the decay of m_buf there as
+        // a use of the uninitialized buffer
+        m_ptr = m_buf;
     }
     MemoryPool(const MemoryPool& other)
     : MemoryPool()
@@ -92,8 +149,9 @@ public:
         return *this;
     }
 
+    // Returns nullptr when the pool is exhausted.
     template <std::size_t ReqAlign>
-    char* allocate(std::size_t n)
+    char* try_allocate(std::size_t n) noexcept
     {
         static_assert(ReqAlign <= alignment, "alignment is too small for this memory pool");
         auto const aligned_n = align_up(n);
@@ -120,15 +178,17 @@ public:
             } while (!m_ptr.compare_exchange_weak(
                 old_ptr, new_ptr, std::memory_order_release, std::memory_order_relaxed));
         }
+        return r;
+    }
 
+    template <std::size_t ReqAlign>
+    char* allocate(std::size_t n)
+    {
+        char* r = try_allocate<ReqAlign>(n);
         if (!r)
         {
-            static_assert(alignment <= alignof(std::max_align_t),
-                          "you've chosen an "
-                          "alignment that is larger than alignof(std::max_align_t), and "
-                          "cannot be guaranteed by normal operator new");
             assert(false && "Memory pool exhausted");
-            return static_cast<char*>(::operator new(n));
+            return detail::allocateFromHeap<alignment>(n);
         }
         return r;
     }
@@ -150,7 +210,7 @@ public:
         }
         else
         {
-            ::operator delete(p);
+            detail::deallocateToHeap<alignment>(p);
         }
     }
 
@@ -158,6 +218,10 @@ public:
     {
         return N;
     }
+    bool owns(const char* p) const noexcept
+    {
+        return m_buf <= p && p < m_buf + N;
+    }
     std::size_t used() const noexcept
     {
         return static_cast<std::size_t>(m_ptr - m_buf);
@@ -166,16 +230,27 @@ public:
     {
         m_ptr = m_buf;
     }
+    // Writes the whole buffer so its pages get mapped now, by the calling thread (and on its NUMA
+    // node), rather than by whichever thread first allocates from them.
+    void prefault() noexcept
+    {
+        std::memset(m_buf, 0, N);
+    }
 };
 
-template <class T, std::size_t N, std::size_t Align>
+// TPool is the pool kind (MemoryPool, ArenaMemoryPool, ...), every allocator with the same
+// template arguments shares one static pool unless constructed from an explicit pool.
+template <class T,
+          std::size_t N,
+          std::size_t Align,
+          template <std::size_t, std::size_t> class TPool>
 class tasks::memory::Allocator
 {
 public:
     using value_type                = T;
     static auto constexpr alignment = Align;
     static auto constexpr size      = N;
-    using memory_pool_type          = MemoryPool<size, alignment>;
+    using memory_pool_type          = TPool<size, alignment>;
 
 private:
     memory_pool_type& m_memory;
@@ -191,8 +266,15 @@ public:
     {
         static_assert(size % alignment == 0, "size N needs to be a multiple of alignment Align");
     }
+    // Allocates from the given pool instead of the static one, the pool must outlive every
+    // allocator copy, including those kept in shared states of futures.
+    explicit Allocator(memory_pool_type& memory) noexcept
+    : m_memory(memory)
+    {
+        static_assert(size % alignment == 0, "size N needs to be a multiple of alignment Align");
+    }
     template <class U>
-    explicit Allocator(const Allocator<U, N, alignment>& a) noexcept
+    explicit Allocator(const Allocator<U, N, alignment, TPool>& a) noexcept
     : m_memory(a.m_memory)
     {
     }
@@ -204,7 +286,7 @@ public:
     template <class _Up>
     struct rebind
     {
-        using other = Allocator<_Up, N, alignment>;
+        using other = Allocator<_Up, N, alignment, TPool>;
     };
 
     T* allocate(std::size_t n)
@@ -217,11 +299,18 @@ public:
         m_memory.deallocate(reinterpret_cast<char*>(p), n * sizeof(T)); // NOLINT
     }
 
-    template <class T1, std::size_t N1, std::size_t A1, class U, std::size_t M, std::size_t A2>
-    friend bool
-    operator==(const Allocator<T1, N1, A1>& x, const Allocator<U, M, A2>& y) noexcept; // NOLINT
+    template <class T1,
+              std::size_t N1,
+              std::size_t A1,
+              template <std::size_t, std::size_t> class P1,
+              class U,
+              std::size_t M,
+              std::size_t A2,
+              template <std::size_t, std::size_t> class P2>
+    friend bool operator==(const Allocator<T1, N1, A1, P1>& x,
+                           const Allocator<U, M, A2, P2>& y) noexcept; // NOLINT
 
-    template <class U, std::size_t M, std::size_t A>
+    template <class U, std::size_t M, std::size_t A, template <std::size_t, std::size_t> class P>
     friend class Allocator;
 };
 
@@ -229,14 +318,113 @@ namespace tasks
 {
     namespace memory
     {
-        template <class T, std::size_t N, std::size_t A1, class U, std::size_t M, std::size_t A2>
-        inline bool operator==(const Allocator<T, N, A1>& x, const Allocator<U, M, A2>& y) noexcept
+        template <class T,
+                  std::size_t N,
+                  std::size_t A1,
+                  template <std::size_t, std::size_t> class P1,
+                  class U,
+                  std::size_t M,
+                  std::size_t A2,
+                  template <std::size_t, std::size_t> class P2>
+        inline bool operator==(const Allocator<T, N, A1, P1>& x,
+                               const Allocator<U, M, A2, P2>& y) noexcept
         {
-            return N == M && A1 == A2 && &x.m_memory == &y.m_memory;
+            return N == M && A1 == A2 &&
+                   static_cast<const void*>(&x.m_memory) == static_cast<const void*>(&y.m_memory);
         }
 
-        template <class T, std::size_t N, std::size_t A1, class U, std::size_t M, std::size_t A2>
-        inline bool operator!=(const Allocator<T, N, A1>& x, const Allocator<U, M, A2>& y) noexcept
+        template <class T,
+                  std::size_t N,
+                  std::size_t A1,
+                  template <std::size_t, std::size_t> class P1,
+                  class U,
+                  std::size_t M,
+                  std::size_t A2,
+                  template <std::size_t, std::size_t> class P2>
+        inline bool operator!=(const Allocator<T, N, A1, P1>& x,
+                               const Allocator<U, M, A2, P2>& y) noexcept
+        {
+            return !(x == y);
+        }
+    }
+}
+
+// Allocator drawing from a pool instance rather than from the hidden static pool of Allocator, so
+// that every owner of a pool, e.g. a threadsafe::Queue, has memory of its own. Copies and rebinds
+// borrow the same pool without any reference counting: copying one costs a pointer copy, and the
+// pool has to outlive every copy, including those held by tasks and futures.
+template <class T,
+          std::size_t N,
+          std::size_t Align,
+          template <std::size_t, std::size_t> class TPool>
+class tasks::memory::AllocatorWithInternalMemory
+{
+public:
+    using value_type                = T;
+    static auto constexpr alignment = Align;
+    static auto constexpr size      = N;
+    using memory_pool_type          = TPool<size, alignment>;
+
+private:
+    memory_pool_type* m_memory;
+
+public:
+    explicit AllocatorWithInternalMemory(memory_pool_type& memory) noexcept
+    : m_memory(&memory)
+    {
+        static_assert(size % alignment == 0, "size N needs to be a multiple of alignment Align");
+    }
+    template <class U>
+    explicit AllocatorWithInternalMemory(
+        const AllocatorWithInternalMemory<U, N, alignment, TPool>& a) noexcept
+    : m_memory(a.m_memory)
+    {
+    }
+    template <class _Up>
+    struct rebind
+    {
+        using other = AllocatorWithInternalMemory<_Up, N, alignment, TPool>;
+    };
+
+    T* allocate(std::size_t n)
+    {
+        return reinterpret_cast<T*>(
+            m_memory->template allocate<alignof(T)>(n * sizeof(T))); // NOLINT
+    }
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        m_memory->deallocate(reinterpret_cast<char*>(p), n * sizeof(T)); // NOLINT
+    }
+    memory_pool_type& pool() const noexcept
+    {
+        return *m_memory;
+    }
+
+    template <class U, std::size_t M, std::size_t A, template <std::size_t, std::size_t> class P>
+    friend class AllocatorWithInternalMemory;
+};
+
+namespace tasks
+{
+    namespace memory
+    {
+        template <class T,
+                  class U,
+                  std::size_t N,
+                  std::size_t A,
+                  template <std::size_t, std::size_t> class P>
+        inline bool operator==(const AllocatorWithInternalMemory<T, N, A, P>& x,
+                               const AllocatorWithInternalMemory<U, N, A, P>& y) noexcept
+        {
+            return &x.pool() == &y.pool();
+        }
+        template <class T,
+                  class U,
+                  std::size_t N,
+                  std::size_t A,
+                  template <std::size_t, std::size_t> class P>
+        inline bool operator!=(const AllocatorWithInternalMemory<T, N, A, P>& x,
+                               const AllocatorWithInternalMemory<U, N, A, P>& y) noexcept
         {
             return !(x == y);
         }
@@ -0,0 +1,275 @@
+#ifndef TASKS_ARENA_MEMORY_POOL_H
+#define TASKS_ARENA_MEMORY_POOL_H
+
+#include "Allocator.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+namespace tasks
+{
+    namespace memory
+    {
+        template <std::size_t N, std::size_t alignment = alignof(std::max_align_t)>
+        class ArenaMemoryPool;
+    }
+}
+
+// Pool split into fixed chunks, every thread bump-allocating from a private chunk (its arena), so
+// allocating touches no shared state but on a chunk refill. Each chunk counts its live blocks and
+// goes back to the pool as soon as the last one is released, whichever thread releases it, so
+// memory allocated by a producer and freed by a consumer is recycled. The owning thread keeps the
+// count of its arena to itself and publishes it once it moves on to another chunk or exits. A
+// thread's chunk with no live block left is rewound in place, and releasing the most recent block
+// of the calling thread's chunk rewinds it as well.
+// Requests larger than half a chunk take a chunk of their own. Requests larger than a chunk, or
+// made when every chunk is taken, assert and fall back to the heap.
+template <std::size_t N, std::size_t alignment>
+class tasks::memory::ArenaMemoryPool
+{
+public:
+    static constexpr std::size_t chunk_size =
+        std::max(alignment, std::min<std::size_t>(16384, N / 16) / alignment * alignment);
+    static constexpr std::size_t chunk_count = N / chunk_size;
+
+private:
+    static constexpr std::size_t m_maxArenaRequest{chunk_size / 2};
+    static constexpr int m_arenasPerThread{4};
+    // A chunk state holds the number of live blocks, and a chunk whose state is 0 is free. While
+    // a chunk is some thread's arena, its state is m_arenaBias minus the blocks released by other
+    // threads: the owner retires it by taking off m_arenaBias less the blocks it allocated.
+    static constexpr uint64_t m_arenaBias{uint64_t(1) << 62};
+
+    struct Arena
+    {
+        uint64_t owner{0};
+        std::size_t chunk{0};
+        char* ptr{nullptr};
+        char* end{nullptr};
+        // blocks allocated from the chunk and not released by the owner
+        uint64_t count{0};
+    };
+    // The arenas of a thread go back to their pools when the thread exits.
+    struct ThreadArenas
+    {
+        Arena arenas[m_arenasPerThread];
+
+        ~ThreadArenas()
+        {
+            for (auto& arena : arenas)
+                retire(arena);
+        }
+    };
+    struct alignas(64) Chunk
+    {
+        std::atomic<uint64_t> state{0};
+    };
+    // Arenas are keyed by an id unique to each pool instance and reset, never by address, so a
+    // pool created where another one used to live does not pick up its stale chunks. A thread
+    // using more pools at once than it has arenas retires the arena it reuses.
+    static inline thread_local ThreadArenas t_arenas;
+    static inline std::atomic<uint64_t> s_nextId{1};
+    // live pools, where an arena finds its pool back to be retired
+    static inline std::mutex s_poolsMutex;
+    static inline ArenaMemoryPool* s_pools{nullptr};
+
+    alignas(alignment) char m_buf[N];
+    Chunk m_chunks[chunk_count];
+    std::atomic<std::size_t> m_nextChunk{0};
+    std::atomic<uint64_t> m_id{s_nextId.fetch_add(1, std::memory_order_relaxed)};
+    ArenaMemoryPool* m_nextPool{nullptr};
+
+    static std::size_t align_up(std::size_t n) noexcept
+    {
+        return (n + (alignment - 1)) & ~(alignment - 1);
+    }
+    static Arena* findArena(uint64_t id) noexcept
+    {
+        for (auto& arena : t_arenas.arenas)
+        {
+            if (arena.owner == id)
+                return &arena;
+        }
+        return nullptr;
+    }
+    // Hands the chunk of arena back to its pool, if that pool is still alive and not reset.
+    static void retire(Arena& arena)
+    {
+        if (arena.ptr)
+        {
+            std::lock_guard<std::mutex> lock(s_poolsMutex);
+            for (auto* pool = s_pools; pool; pool = pool->m_nextPool)
+            {
+                if (pool->m_id.load(std::memory_order_relaxed) == arena.owner)
+                {
+                    pool->retireChunk(arena);
+                    break;
+                }
+            }
+        }
+        arena = Arena{};
+    }
+    void retireChunk(const Arena& arena) noexcept
+    {
+        m_chunks[arena.chunk].state.fetch_sub(m_arenaBias - arena.count,
+                                              std::memory_order_acq_rel);
+    }
+    char* chunkBegin(std::size_t chunk) noexcept
+    {
+        return m_buf + chunk * chunk_size;
+    }
+    // Takes a free chunk with the given initial state, returns chunk_count when there is none.
+    std::size_t claimChunk(uint64_t state) noexcept
+    {
+        const auto start = m_nextChunk.fetch_add(1, std::memory_order_relaxed);
+        for (std::size_t i = 0; i < chunk_count; i++)
+        {
+            const auto chunk = (start + i) % chunk_count;
+            uint64_t free    = 0;
+            if (m_chunks[chunk].state.compare_exchange_strong(
+                    free, state, std::memory_order_acquire, std::memory_order_relaxed))
+                return chunk;
+        }
+        return chunk_count;
+    }
+    bool refill(Arena& arena) noexcept
+    {
+        if (arena.ptr)
+        {
+            // nothing of the current chunk is alive anymore, start over in place
+            auto idle = m_arenaBias - arena.count;
+            if (m_chunks[arena.chunk].state.compare_exchange_strong(
+                    idle, m_arenaBias, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                arena.ptr   = chunkBegin(arena.chunk);
+                arena.count = 0;
+                return true;
+            }
+            const auto chunk = claimChunk(m_arenaBias);
+            if (chunk == chunk_count)
+                return false;
+            retireChunk(arena);
+            arena.chunk = chunk;
+        }
+        else
+        {
+            arena.chunk = claimChunk(m_arenaBias);
+            if (arena.chunk == chunk_count)
+                return false;
+        }
+        arena.ptr   = chunkBegin(arena.chunk);
+        arena.end   = arena.ptr + chunk_size;
+        arena.count = 0;
+        return true;
+    }
+    static char* allocateFromHeap(std::size_t n)
+    {
+        assert(false && "Memory pool exhausted");
+        return detail::allocateFromHeap<alignment>(n);
+    }
+
+public:
+    ArenaMemoryPool()
+    {
+        static_assert(chunk_count > 0, "memory pool is smaller than a chunk");
+        static_assert(alignment <= max_pool_alignment, "alignment is larger than a page");
+        std::lock_guard<std::mutex> lock(s_poolsMutex);
+        m_nextPool = s_pools;
+        s_pools    = this;
+    }
+    ArenaMemoryPool(const ArenaMemoryPool&) = delete;
+    ArenaMemoryPool& operator=(const ArenaMemoryPool&) = delete;
+    ~ArenaMemoryPool()
+    {
+        std::lock_guard<std::mutex> lock(s_poolsMutex);
+        auto** link = &s_pools;
+        while (*link != this)
+            link = &(*link)->m_nextPool;
+        *link = m_nextPool;
+    }
+
+    template <std::size_t ReqAlign>
+    char* allocate(std::size_t n)
+    {
+        static_assert(ReqAlign <= alignment, "alignment is too small for this memory pool");
+        auto const aligned_n = align_up(n);
+        if (aligned_n > m_maxArenaRequest)
+        {
+            const auto chunk = aligned_n <= chunk_size ? claimChunk(1) : chunk_count;
+            if (chunk == chunk_count)
+                return allocateFromHeap(n);
+            return chunkBegin(chunk);
+        }
+
+        const auto id = m_id.load(std::memory_order_relaxed);
+        auto* arena   = findArena(id);
+        if (!arena)
+        {
+            arena = &t_arenas.arenas[id % m_arenasPerThread];
+            retire(*arena);
+            arena->owner = id;
+        }
+        if (static_cast<std::size_t>(arena->end - arena->ptr) < aligned_n && !refill(*arena))
+            return allocateFromHeap(n);
+        arena->count++;
+        char* r = arena->ptr;
+        arena->ptr += aligned_n;
+        return r;
+    }
+    void deallocate(char* p, std::size_t n) noexcept
+    {
+        if (!owns(p))
+        {
+            detail::deallocateToHeap<alignment>(p);
+            return;
+        }
+        const auto chunk = static_cast<std::size_t>(p - m_buf) / chunk_size;
+        auto* arena      = findArena(m_id.load(std::memory_order_relaxed));
+        if (arena && arena->ptr && arena->chunk == chunk)
+        {
+            // the block was never published, the owner takes it off its own count
+            if (arena->ptr == p + align_up(n))
+                arena->ptr = p;
+            arena->count--;
+            return;
+        }
+        m_chunks[chunk].state.fetch_sub(1, std::memory_order_release);
+    }
+
+    static constexpr std::size_t size() noexcept
+    {
+        return N;
+    }
+    bool owns(const char* p) const noexcept
+    {
+        return m_buf <= p && p < m_buf + chunk_count * chunk_size;
+    }
+    // bytes of the chunks taken, as the arena of a thread or by live blocks
+    std::size_t used() const noexcept
+    {
+        std::size_t bytes = 0;
+        for (const auto& chunk : m_chunks)
+        {
+            if (chunk.state.load(std::memory_order_relaxed) != 0)
+                bytes += chunk_size;
+        }
+        return bytes;
+    }
+    // Only safe once no thread allocates from or holds memory of the pool anymore.
+    void reset() noexcept
+    {
+        m_id.store(s_nextId.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+        for (auto& chunk : m_chunks)
+            chunk.state.store(0, std::memory_order_relaxed);
+    }
+    void prefault() noexcept
+    {
+        std::memset(m_buf, 0, N);
+    }
+};
+
+#endif // TASKS_ARENA_MEMORY_POOL_H
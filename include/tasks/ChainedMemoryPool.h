@@ -0,0 +1,250 @@
+#ifndef TASKS_CHAINED_MEMORY_POOL_H
+#define TASKS_CHAINED_MEMORY_POOL_H
+
+#include "Allocator.h"
+#include "Pages.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <new>
+
+namespace tasks
+{
+    namespace memory
+    {
+        struct GrowthEvent
+        {
+            int chunks{0};            // chunks in the pool after growing
+            std::size_t capacity{0};  // bytes in the pool after growing
+        };
+
+        template <std::size_t N, std::size_t alignment = alignof(std::max_align_t)>
+        class ChainedMemoryPool;
+    }
+}
+
+// Pool made of a chain of N byte chunks: the internal buffer plus up to chunk_limit() - 1 chunks
+// mapped from the OS, either up front with reserve() or on demand when every chunk is full.
+// Each chunk bump-allocates and counts its live blocks, a chunk whose last block is released starts
+// over from its beginning. Running out of chunks throws std::bad_alloc, the pool never falls back
+// to the global heap.
+template <std::size_t N, std::size_t alignment>
+class tasks::memory::ChainedMemoryPool
+{
+public:
+    static constexpr int max_chunks = 64;
+    using growth_handler            = std::function<void(const GrowthEvent&)>;
+
+private:
+    // The chunk state packs the live block count above the 32 bit bump offset, so claiming space
+    // and rewinding an empty chunk are single CAS operations that cannot interleave.
+    struct alignas(64) Chunk
+    {
+        char* base{nullptr};
+        std::atomic<uint64_t> state{0};
+    };
+    static constexpr uint64_t m_offsetMask{0xffffffff};
+    static constexpr uint64_t m_oneBlock{uint64_t(1) << 32};
+
+    alignas(alignment) char m_buf[N];
+    Chunk m_chunks[max_chunks];
+    std::atomic<int> m_chunkCount{1};
+    std::atomic<int> m_current{0};
+    int m_chunkLimit{8};
+    std::atomic<int> m_growthCount{0};
+    growth_handler m_onGrowth;
+    std::mutex m_growthMutex;
+
+    static std::size_t align_up(std::size_t n) noexcept
+    {
+        return (n + (alignment - 1)) & ~(alignment - 1);
+    }
+    static char* claim(Chunk& chunk, std::size_t n) noexcept
+    {
+        auto state = chunk.state.load(std::memory_order_relaxed);
+        do
+        {
+            if (N - (state & m_offsetMask) < n)
+                return nullptr;
+        } while (!chunk.state.compare_exchange_weak(
+            state, state + m_oneBlock + n, std::memory_order_acquire, std::memory_order_relaxed));
+        return chunk.base + (state & m_offsetMask);
+    }
+    int chunkIndex(const char* p) const noexcept
+    {
+        const int count = m_chunkCount.load(std::memory_order_acquire);
+        for (int i = 0; i < count; i++)
+        {
+            const auto& chunk = m_chunks[i];
+            if (chunk.base <= p && p < chunk.base + N)
+                return i;
+        }
+        return -1;
+    }
+    bool addChunk() noexcept
+    {
+        const int count = m_chunkCount.load(std::memory_order_relaxed);
+        if (count >= m_chunkLimit)
+            return false;
+        auto* base = static_cast<char*>(mapPages(N));
+        if (!base)
+            return false;
+        m_chunks[count].base = base;
+        m_chunks[count].state.store(0, std::memory_order_relaxed);
+        m_chunkCount.store(count + 1, std::memory_order_release);
+        return true;
+    }
+    char* allocateSlow(std::size_t n)
+    {
+        std::lock_guard<std::mutex> lock(m_growthMutex);
+        int count = m_chunkCount.load(std::memory_order_relaxed);
+        for (int i = 0; i < count; i++)
+        {
+            if (char* r = claim(m_chunks[i], n))
+            {
+                m_current.store(i, std::memory_order_relaxed);
+                return r;
+            }
+        }
+        if (!addChunk())
+            return nullptr;
+        m_growthCount.fetch_add(1, std::memory_order_relaxed);
+        m_current.store(count, std::memory_order_relaxed);
+        char* r = claim(m_chunks[count], n);
+        if (m_onGrowth)
+            m_onGrowth(GrowthEvent{count + 1, capacity()});
+        return r;
+    }
+
+public:
+    ChainedMemoryPool() noexcept
+    {
+        static_assert(N <= m_offsetMask, "memory pool chunks are limited to 4 GiB");
+        static_assert(N % alignment == 0, "size N needs to be a multiple of alignment");
+        static_assert(alignment <= max_pool_alignment, "alignment is larger than a page");
+        m_chunks[0].base = m_buf;
+    }
+    ChainedMemoryPool(const ChainedMemoryPool&) = delete;
+    ChainedMemoryPool& operator=(const ChainedMemoryPool&) = delete;
+    ~ChainedMemoryPool()
+    {
+        const int count = m_chunkCount.load(std::memory_order_acquire);
+        for (int i = 1; i < count; i++)
+            unmapPages(m_chunks[i].base, N);
+    }
+
+    // Configuration, to be done before the pool is shared with other threads.
+    // Maximum number of chunks, the internal buffer included.
+    void set_chunk_limit(int chunks) noexcept
+    {
+        m_chunkLimit = std::clamp(chunks, m_chunkCount.load(std::memory_order_relaxed), max_chunks);
+    }
+    // Called, under the growth lock, from the allocating thread whenever the pool maps a new chunk
+    // on demand. It must not allocate from this pool.
+    void set_growth_handler(growth_handler handler)
+    {
+        m_onGrowth = std::move(handler);
+    }
+    // Maps chunks up front until the pool holds the given number of chunks, within the limit.
+    // Returns the number of chunks.
+    int reserve(int chunks) noexcept
+    {
+        std::lock_guard<std::mutex> lock(m_growthMutex);
+        while (m_chunkCount.load(std::memory_order_relaxed) < chunks && addChunk())
+        {
+        }
+        return m_chunkCount.load(std::memory_order_relaxed);
+    }
+
+    // Returns nullptr when every chunk is full and the pool may not grow any further.
+    template <std::size_t ReqAlign>
+    char* try_allocate(std::size_t n)
+    {
+        static_assert(ReqAlign <= alignment, "alignment is too small for this memory pool");
+        auto const aligned_n = align_up(n);
+        if (aligned_n > N)
+            return nullptr;
+        if (char* r = claim(m_chunks[m_current.load(std::memory_order_relaxed)], aligned_n))
+            return r;
+        return allocateSlow(aligned_n);
+    }
+    template <std::size_t ReqAlign>
+    char* allocate(std::size_t n)
+    {
+        char* r = try_allocate<ReqAlign>(n);
+        if (!r)
+            throw std::bad_alloc();
+        return r;
+    }
+    void deallocate(char* p, std::size_t) noexcept
+    {
+        const int index = chunkIndex(p);
+        assert(index >= 0 && "Pointer was not allocated from this memory pool");
+        if (index < 0)
+            return;
+        auto& chunk = m_chunks[index];
+        auto state  = chunk.state.load(std::memory_order_relaxed);
+        uint64_t next = 0;
+        do
+        {
+            next = state - m_oneBlock;
+            if ((next >> 32) == 0)
+                next = 0;
+        } while (!chunk.state.compare_exchange_weak(
+            state, next, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    static constexpr std::size_t size() noexcept
+    {
+        return N;
+    }
+    bool owns(const char* p) const noexcept
+    {
+        return chunkIndex(p) >= 0;
+    }
+    // bytes handed out from chunks that still hold live blocks
+    std::size_t used() const noexcept
+    {
+        std::size_t bytes = 0;
+        const int count   = m_chunkCount.load(std::memory_order_acquire);
+        for (int i = 0; i < count; i++)
+            bytes += m_chunks[i].state.load(std::memory_order_relaxed) & m_offsetMask;
+        return bytes;
+    }
+    std::size_t capacity() const noexcept
+    {
+        return std::size_t(m_chunkCount.load(std::memory_order_acquire)) * N;
+    }
+    int chunk_count() const noexcept
+    {
+        return m_chunkCount.load(std::memory_order_acquire);
+    }
+    int chunk_limit() const noexcept
+    {
+        return m_chunkLimit;
+    }
+    // number of chunks mapped on demand, reserve() excluded
+    int growth_count() const noexcept
+    {
+        return m_growthCount.load(std::memory_order_relaxed);
+    }
+    // Rewinds every chunk, mapped chunks are kept. Only safe once no block is in use anymore.
+    void reset() noexcept
+    {
+        const int count = m_chunkCount.load(std::memory_order_acquire);
+        for (int i = 0; i < count; i++)
+            m_chunks[i].state.store(0, std::memory_order_relaxed);
+        m_current.store(0, std::memory_order_release);
+    }
+    void prefault() noexcept
+    {
+        std::memset(m_buf, 0, N);
+    }
+};
+
+#endif // TASKS_CHAINED_MEMORY_POOL_H
@@ -0,0 +1,51 @@
+#ifndef TASKS_COMPLETION_COUNTER_H
+#define TASKS_COMPLETION_COUNTER_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace tasks
+{
+    class CompletionCounter;
+}
+
+// Counts tasks that have been submitted but not yet run. Used instead of futures by callers that
+// only need to know when a group of fire-and-forget tasks has finished.
+class tasks::CompletionCounter final
+{
+    std::atomic<int64_t> m_pending{0};
+
+public:
+    CompletionCounter() noexcept                         = default;
+    CompletionCounter(const CompletionCounter&)            = delete;
+    CompletionCounter& operator=(const CompletionCounter&) = delete;
+    ~CompletionCounter()                                   = default;
+
+    void increment(int64_t n = 1) noexcept
+    {
+        m_pending.fetch_add(n, std::memory_order_relaxed);
+    }
+    // Returns true when this brought the count down to zero.
+    bool decrement(int64_t n = 1) noexcept
+    {
+        return m_pending.fetch_sub(n, std::memory_order_release) == n;
+    }
+    int64_t pending() const noexcept
+    {
+        return m_pending.load(std::memory_order_acquire);
+    }
+    bool done() const noexcept
+    {
+        return pending() == 0;
+    }
+    void wait() const noexcept
+    {
+        while (!done())
+        {
+            std::this_thread::yield();
+        }
+    }
+};
+
+#endif // TASKS_COMPLETION_COUNTER_H
@@ -0,0 +1,143 @@
+#ifndef TASKS_DYNAMIC_MEMORY_POOL_H
+#define TASKS_DYNAMIC_MEMORY_POOL_H
+
+#include "Allocator.h"
+#include "Pages.h"
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+namespace tasks
+{
+    namespace memory
+    {
+        template <std::size_t N, std::size_t alignment = alignof(std::max_align_t)>
+        class DynamicMemoryPool;
+        template <std::size_t N, std::size_t alignment = alignof(std::max_align_t)>
+        class LockedMemoryPool;
+    }
+}
+
+// Pool whose buffer size is chosen at construction, N only being the default. The buffer is mapped
+// from the OS once, optionally on huge pages, prefaulted and locked (see PageOptions). Allocation
+// bumps an offset packed with the live block count, so the buffer starts over as soon as its last
+// block is released, whatever the release order. Exhaustion throws std::bad_alloc.
+template <std::size_t N, std::size_t alignment>
+class tasks::memory::DynamicMemoryPool
+{
+    static constexpr uint64_t m_offsetMask{0xffffffff};
+    static constexpr uint64_t m_oneBlock{uint64_t(1) << 32};
+
+    std::size_t m_size;
+    Mapping m_mapping;
+    char* m_buf;
+    std::atomic<uint64_t> m_state{0};
+
+    static std::size_t align_up(std::size_t n) noexcept
+    {
+        return (n + (alignment - 1)) & ~(alignment - 1);
+    }
+
+public:
+    explicit DynamicMemoryPool(std::size_t bytes = N, const PageOptions& options = {})
+    : m_size(align_up(bytes))
+    , m_mapping(mapPages(m_size, options))
+    , m_buf(static_cast<char*>(m_mapping.data))
+    {
+        static_assert(alignment <= max_pool_alignment, "alignment is larger than a page");
+        assert(m_size <= m_offsetMask && "memory pool is limited to 4 GiB");
+        if (!m_buf)
+            throw std::bad_alloc();
+    }
+    DynamicMemoryPool(const DynamicMemoryPool&) = delete;
+    DynamicMemoryPool& operator=(const DynamicMemoryPool&) = delete;
+    ~DynamicMemoryPool()
+    {
+        unmapPages(m_mapping);
+    }
+
+    // Returns nullptr when the pool is exhausted.
+    template <std::size_t ReqAlign>
+    char* try_allocate(std::size_t n) noexcept
+    {
+        static_assert(ReqAlign <= alignment, "alignment is too small for this memory pool");
+        auto const aligned_n = align_up(n);
+        auto state           = m_state.load(std::memory_order_relaxed);
+        do
+        {
+            if (m_size - (state & m_offsetMask) < aligned_n)
+                return nullptr;
+        } while (!m_state.compare_exchange_weak(state,
+                                                state + m_oneBlock + aligned_n,
+                                                std::memory_order_acquire,
+                                                std::memory_order_relaxed));
+        return m_buf + (state & m_offsetMask);
+    }
+    template <std::size_t ReqAlign>
+    char* allocate(std::size_t n)
+    {
+        char* r = try_allocate<ReqAlign>(n);
+        if (!r)
+            throw std::bad_alloc();
+        return r;
+    }
+    void deallocate(char* p, std::size_t) noexcept
+    {
+        assert(owns(p) && "Pointer was not allocated from this memory pool");
+        (void)p;
+        auto state    = m_state.load(std::memory_order_relaxed);
+        uint64_t next = 0;
+        do
+        {
+            next = state - m_oneBlock;
+            if ((next >> 32) == 0)
+                next = 0;
+        } while (!m_state.compare_exchange_weak(
+            state, next, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    std::size_t size() const noexcept
+    {
+        return m_size;
+    }
+    bool owns(const char* p) const noexcept
+    {
+        return m_buf <= p && p < m_buf + m_size;
+    }
+    // which of the requested page options the buffer got
+    const Mapping& mapping() const noexcept
+    {
+        return m_mapping;
+    }
+    std::size_t used() const noexcept
+    {
+        return m_state.load(std::memory_order_relaxed) & m_offsetMask;
+    }
+    // Only safe once no block of the pool is in use anymore.
+    void reset() noexcept
+    {
+        m_state.store(0, std::memory_order_release);
+    }
+    void prefault() noexcept
+    {
+        std::memset(m_buf, 0, m_size);
+    }
+};
+
+// DynamicMemoryPool with PageOptions::realtime(): huge pages when available, every page faulted in
+// and locked at construction, so neither a page fault nor a TLB miss storm hits the first tasks of
+// a realtime thread. Each option silently falls back when the system refuses it, see mapping().
+template <std::size_t N, std::size_t alignment>
+class tasks::memory::LockedMemoryPool final : public DynamicMemoryPool<N, alignment>
+{
+public:
+    explicit LockedMemoryPool(std::size_t bytes = N)
+    : DynamicMemoryPool<N, alignment>(bytes, PageOptions::realtime())
+    {
+    }
+};
+
+#endif // TASKS_DYNAMIC_MEMORY_POOL_H
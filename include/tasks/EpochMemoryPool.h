@@ -0,0 +1,223 @@
+#ifndef TASKS_EPOCH_MEMORY_POOL_H
+#define TASKS_EPOCH_MEMORY_POOL_H
+
+#include "Allocator.h"
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <thread>
+
+namespace tasks
+{
+    namespace memory
+    {
+        template <std::size_t N, std::size_t alignment = alignof(std::max_align_t)>
+        class EpochMemoryPool;
+    }
+}
+
+// Pool for frame based workloads. Allocations bump a pointer in the arena of the current epoch,
+// advance() opens the next epoch and seals the current one. A sealed epoch's arena is reset as soon
+// as its last block is released, so everything a frame allocated (tasks, shared states, scratch
+// containers) is reclaimed at once when the frame's work is done, without ever calling reset() by
+// hand. Every block is counted against its epoch until it is destroyed, which makes the reset safe
+// even while futures or tasks of the epoch are still alive.
+// A task stored inline in a queue slot allocates nothing, so a threadsafe::Queue on this pool
+// pins the epoch of every task it takes and unpins it once the task has run: an epoch becomes
+// quiescent once all of its tasks are done, inline ones included.
+// The buffer is split into epoch_count arenas of N / epoch_count bytes, so up to epoch_count - 1
+// sealed epochs can still be draining while the current one allocates.
+template <std::size_t N, std::size_t alignment>
+class tasks::memory::EpochMemoryPool
+{
+public:
+    static constexpr int epoch_count         = 4;
+    static constexpr std::size_t arena_size = N / epoch_count / alignment * alignment;
+
+private:
+    // An arena state packs an open flag and the live block count above the 32 bit bump offset:
+    // allocating, releasing, sealing and resetting are single CAS operations on it.
+    static constexpr uint64_t m_offsetMask{0xffffffff};
+    static constexpr uint64_t m_oneBlock{uint64_t(1) << 32};
+    static constexpr uint64_t m_openFlag{uint64_t(1) << 63};
+    static constexpr uint64_t m_countMask{~m_openFlag & ~m_offsetMask};
+
+    struct alignas(64) Arena
+    {
+        std::atomic<uint64_t> state{0};
+    };
+
+    alignas(alignment) char m_buf[N];
+    Arena m_arenas[epoch_count];
+    std::atomic<uint64_t> m_epoch{0};
+
+    static std::size_t align_up(std::size_t n) noexcept
+    {
+        return (n + (alignment - 1)) & ~(alignment - 1);
+    }
+    static int arenaOf(uint64_t epoch) noexcept
+    {
+        return static_cast<int>(epoch % epoch_count);
+    }
+    char* arenaBegin(int arena) noexcept
+    {
+        return m_buf + std::size_t(arena) * arena_size;
+    }
+    // Drops one block, or the open flag, and resets the arena once both are gone.
+    void release(Arena& arena, uint64_t amount) noexcept
+    {
+        auto state    = arena.state.load(std::memory_order_relaxed);
+        uint64_t next = 0;
+        do
+        {
+            next = state - amount;
+            if ((next & (m_openFlag | m_countMask)) == 0)
+                next = 0;
+        } while (!arena.state.compare_exchange_weak(
+            state, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+    }
+
+public:
+    EpochMemoryPool() noexcept
+    {
+        static_assert(arena_size > 0, "memory pool is too small for its epochs");
+        static_assert(arena_size <= m_offsetMask, "epoch arenas are limited to 4 GiB");
+        static_assert(alignment <= max_pool_alignment, "alignment is larger than a page");
+        m_arenas[0].state.store(m_openFlag, std::memory_order_relaxed);
+    }
+    EpochMemoryPool(const EpochMemoryPool&) = delete;
+    EpochMemoryPool& operator=(const EpochMemoryPool&) = delete;
+    ~EpochMemoryPool()                                 = default;
+
+    // Returns nullptr when the arena of the current epoch is full.
+    template <std::size_t ReqAlign>
+    char* try_allocate(std::size_t n) noexcept
+    {
+        static_assert(ReqAlign <= alignment, "alignment is too small for this memory pool");
+        auto const aligned_n = align_up(n);
+        for (;;)
+        {
+            const auto epoch = m_epoch.load(std::memory_order_acquire);
+            const int index  = arenaOf(epoch);
+            auto& arena      = m_arenas[index];
+            auto state       = arena.state.load(std::memory_order_relaxed);
+            do
+            {
+                // sealed by a concurrent advance(), retry in the new epoch
+                if (!(state & m_openFlag))
+                    break;
+                if (arena_size - (state & m_offsetMask) < aligned_n)
+                    return nullptr;
+            } while (!arena.state.compare_exchange_weak(state,
+                                                        state + m_oneBlock + aligned_n,
+                                                        std::memory_order_acquire,
+                                                        std::memory_order_relaxed));
+            if (state & m_openFlag)
+                return arenaBegin(index) + (state & m_offsetMask);
+        }
+    }
+    template <std::size_t ReqAlign>
+    char* allocate(std::size_t n)
+    {
+        char* r = try_allocate<ReqAlign>(n);
+        if (!r)
+            throw std::bad_alloc();
+        return r;
+    }
+    void deallocate(char* p, std::size_t) noexcept
+    {
+        assert(owns(p) && "Pointer was not allocated from this memory pool");
+        release(m_arenas[static_cast<std::size_t>(p - m_buf) / arena_size], m_oneBlock);
+    }
+
+    // Holds the current epoch like a live block would, without allocating, e.g. for work that
+    // belongs to the epoch but is not a queued task. Returns the epoch to pass to unpin().
+    uint64_t pin() noexcept
+    {
+        for (;;)
+        {
+            const auto epoch = m_epoch.load(std::memory_order_acquire);
+            auto& arena      = m_arenas[arenaOf(epoch)];
+            auto state       = arena.state.load(std::memory_order_relaxed);
+            do
+            {
+                if (!(state & m_openFlag))
+                    break;
+            } while (!arena.state.compare_exchange_weak(
+                state, state + m_oneBlock, std::memory_order_acquire, std::memory_order_relaxed));
+            if (state & m_openFlag)
+                return epoch;
+        }
+    }
+    void unpin(uint64_t epoch) noexcept
+    {
+        release(m_arenas[arenaOf(epoch)], m_oneBlock);
+    }
+
+    uint64_t current_epoch() const noexcept
+    {
+        return m_epoch.load(std::memory_order_acquire);
+    }
+    // True once epoch is sealed and every block allocated in it has been released.
+    bool is_quiescent(uint64_t epoch) const noexcept
+    {
+        const auto current = current_epoch();
+        if (epoch >= current)
+            return false;
+        if (current - epoch >= epoch_count)
+            return true;
+        return m_arenas[arenaOf(epoch)].state.load(std::memory_order_acquire) == 0;
+    }
+    // Seals the current epoch and opens the next one. Fails while the arena the next epoch needs
+    // still holds blocks of the epoch epoch_count - 1 advances ago. Only one thread may advance.
+    bool try_advance() noexcept
+    {
+        const auto epoch = m_epoch.load(std::memory_order_relaxed);
+        auto& next       = m_arenas[arenaOf(epoch + 1)];
+        uint64_t free    = 0;
+        if (!next.state.compare_exchange_strong(
+                free, m_openFlag, std::memory_order_acquire, std::memory_order_relaxed))
+            return false;
+        m_epoch.store(epoch + 1, std::memory_order_release);
+        release(m_arenas[arenaOf(epoch)], m_openFlag);
+        return true;
+    }
+    // Same as above, waiting for the next arena to drain. Returns the new epoch.
+    uint64_t advance() noexcept
+    {
+        while (!try_advance())
+            std::this_thread::yield();
+        return current_epoch();
+    }
+
+    static constexpr std::size_t size() noexcept
+    {
+        return N;
+    }
+    bool owns(const char* p) const noexcept
+    {
+        return m_buf <= p && p < m_buf + arena_size * epoch_count;
+    }
+    // bytes allocated in the current epoch
+    std::size_t used() const noexcept
+    {
+        return m_arenas[arenaOf(current_epoch())].state.load(std::memory_order_relaxed) &
+               m_offsetMask;
+    }
+    // Only safe once no block of the pool is in use anymore.
+    void reset() noexcept
+    {
+        for (auto& arena : m_arenas)
+            arena.state.store(0, std::memory_order_relaxed);
+        m_arenas[arenaOf(current_epoch())].state.store(m_openFlag, std::memory_order_release);
+    }
+    void prefault() noexcept
+    {
+        std::memset(m_buf, 0, N);
+    }
+};
+
+#endif // TASKS_EPOCH_MEMORY_POOL_H
@@ -0,0 +1,118 @@
+#ifndef TASKS_EVENT_COUNT_H
+#define TASKS_EVENT_COUNT_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace tasks
+{
+    namespace threadsafe
+    {
+        class EventCount;
+    }
+}
+
+// Lets idle threads park until some producer signals new work, while keeping the signalling side
+// at a fence and a load as long as nobody is parked. A waiter announces itself before checking
+// its wake-up condition one last time:
+//
+//   auto key = events.prepare_wait();
+//   if (workAvailable()) events.cancel_wait(); else events.wait(key);
+//
+// and producers make their work visible before calling notify_one().
+class tasks::threadsafe::EventCount final
+{
+    static constexpr uint64_t m_waiterMask{0xffffffff};
+    static constexpr uint64_t m_epochIncrement{uint64_t(1) << 32};
+
+    // high 32 bits: notification epoch, low 32 bits: number of waiters
+    std::atomic<uint64_t> m_state{0};
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+
+    static uint32_t epoch(uint64_t state) noexcept
+    {
+        return static_cast<uint32_t>(state >> 32);
+    }
+
+public:
+    using key_type = uint32_t;
+
+    EventCount() noexcept                  = default;
+    EventCount(const EventCount&)            = delete;
+    EventCount& operator=(const EventCount&) = delete;
+    ~EventCount()                            = default;
+
+    key_type prepare_wait() noexcept
+    {
+        const auto key = epoch(m_state.fetch_add(1, std::memory_order_seq_cst));
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return key;
+    }
+    void cancel_wait() noexcept
+    {
+        m_state.fetch_sub(1, std::memory_order_seq_cst);
+    }
+    void wait(key_type key)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this, key]() {
+                return epoch(m_state.load(std::memory_order_acquire)) != key;
+            });
+        }
+        m_state.fetch_sub(1, std::memory_order_seq_cst);
+    }
+    // Same as above, giving up after timeout. Returns false when it timed out.
+    template <typename TRep, typename TPeriod>
+    bool wait_for(key_type key, const std::chrono::duration<TRep, TPeriod>& timeout)
+    {
+        bool notified = false;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            notified = m_condition.wait_for(lock, timeout, [this, key]() {
+                return epoch(m_state.load(std::memory_order_acquire)) != key;
+            });
+        }
+        m_state.fetch_sub(1, std::memory_order_seq_cst);
+        return notified;
+    }
+    // Wakes up to n parked threads.
+    void notify(int64_t n)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const auto waiters =
+            static_cast<int64_t>(m_state.load(std::memory_order_relaxed) & m_waiterMask);
+        if (waiters == 0 || n <= 0)
+            return;
+
+        m_state.fetch_add(m_epochIncrement, std::memory_order_seq_cst);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (n >= waiters)
+        {
+            m_condition.notify_all();
+        }
+        else
+        {
+            for (int64_t i = 0; i < n; i++)
+                m_condition.notify_one();
+        }
+    }
+    void notify_one()
+    {
+        notify(1);
+    }
+    void notify_all()
+    {
+        notify(int64_t(m_waiterMask));
+    }
+    int64_t waiters() const noexcept
+    {
+        return static_cast<int64_t>(m_state.load(std::memory_order_relaxed) & m_waiterMask);
+    }
+};
+
+#endif // TASKS_EVENT_COUNT_H
@@ -0,0 +1,79 @@
+#ifndef TASKS_FREE_LIST_H
+#define TASKS_FREE_LIST_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace tasks
+{
+    namespace memory
+    {
+        namespace detail
+        {
+            class FreeList;
+        }
+    }
+}
+
+// Lock-free LIFO (Treiber stack) of free blocks inside a buffer, shared by the pools that recycle
+// blocks. Blocks are named by index, offset / granularity + 1 with 0 meaning empty, and the head
+// packs a 32 bit ABA tag above the 32 bit index of the top block. Free blocks store the index of
+// the next free block in their first bytes, so a block must be at least 4 bytes.
+class tasks::memory::detail::FreeList final
+{
+    std::atomic<uint64_t> m_head{0};
+
+    static std::atomic<uint32_t>& nextOf(char* block) noexcept
+    {
+        return *reinterpret_cast<std::atomic<uint32_t>*>(block); // NOLINT
+    }
+
+public:
+    FreeList() noexcept                  = default;
+    FreeList(const FreeList&)            = delete;
+    FreeList& operator=(const FreeList&) = delete;
+    ~FreeList()                          = default;
+
+    // Returns nullptr when the list is empty.
+    char* pop(char* base, std::size_t granularity) noexcept
+    {
+        auto head = m_head.load(std::memory_order_acquire);
+        for (;;)
+        {
+            const auto index = static_cast<uint32_t>(head);
+            if (index == 0)
+                return nullptr;
+            char* block     = base + std::size_t(index - 1) * granularity;
+            const auto next = nextOf(block).load(std::memory_order_relaxed);
+            const auto tag  = (head >> 32) + 1;
+            if (m_head.compare_exchange_weak(
+                    head, (tag << 32) | next, std::memory_order_acquire, std::memory_order_acquire))
+                return block;
+        }
+    }
+    void push(char* base, std::size_t granularity, char* block) noexcept
+    {
+        const auto index = static_cast<uint32_t>(std::size_t(block - base) / granularity + 1);
+        auto head        = m_head.load(std::memory_order_relaxed);
+        ::new (block) std::atomic<uint32_t>(0);
+        for (;;)
+        {
+            nextOf(block).store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+            const auto tag = (head >> 32) + 1;
+            if (m_head.compare_exchange_weak(head,
+                                             (tag << 32) | index,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed))
+                return;
+        }
+    }
+    // Only safe once no thread pushes or pops anymore.
+    void clear() noexcept
+    {
+        m_head.store(0, std::memory_order_relaxed);
+    }
+};
+
+#endif // TASKS_FREE_LIST_H
@@ -0,0 +1,645 @@
+#ifndef TASKS_FUTURE_H
+#define TASKS_FUTURE_H
+
+#include "Task.h"
+#include "ThreadUtilities.h"
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tasks
+{
+    template <typename T>
+    class Future;
+    template <typename T>
+    class Promise;
+
+    // Result of when_any(): index of the first future to become ready, and all of the futures.
+    template <typename TSequence>
+    struct WhenAnyResult
+    {
+        std::size_t index;
+        TSequence futures;
+    };
+
+    namespace detail
+    {
+        template <typename T>
+        class FutureState;
+        template <typename T, typename TAllocator>
+        class AllocatedFutureState;
+
+        // Parks the calling thread as long as word holds value (a futex on Linux), or until
+        // unparkAll(word). Spurious wake-ups are possible.
+        void parkWhile(const std::atomic<uint32_t>& word, uint32_t value) noexcept;
+        void unparkAll(const std::atomic<uint32_t>& word) noexcept;
+    }
+}
+
+// Shared state of a Promise / Future pair. Readiness, an installed continuation, parked waiters
+// and the reference count all live in one 32 bit word, so setting a value is one atomic operation
+// and a waiter that finds the value ready touches nothing else. The state is allocated with the
+// allocator given to the promise and destroyed by whichever side lets go last.
+template <typename T>
+class tasks::detail::FutureState
+{
+    struct Void
+    {
+    };
+
+public:
+    using value_type = std::conditional_t<std::is_void<T>::value, Void, T>;
+
+protected:
+    using destroy_function = void (*)(FutureState*) noexcept;
+
+private:
+    static constexpr uint32_t m_readyFlag{1};
+    static constexpr uint32_t m_continuationFlag{2};
+    static constexpr uint32_t m_parkedFlag{4};
+    static constexpr uint32_t m_oneRef{8};
+
+    mutable std::atomic<uint32_t> m_state{2 * m_oneRef}; // the promise and its future
+    destroy_function m_destroy;
+    std::optional<value_type> m_value;
+    std::exception_ptr m_exception;
+    Task<> m_continuation;
+
+    void complete() noexcept
+    {
+        const auto state = m_state.fetch_or(m_readyFlag, std::memory_order_acq_rel);
+        if (state & m_parkedFlag)
+            unparkAll(m_state);
+        if (state & m_continuationFlag)
+            runContinuation();
+    }
+    void runContinuation() noexcept
+    {
+        auto continuation = std::move(m_continuation);
+        continuation();
+    }
+
+protected:
+    explicit FutureState(destroy_function destroy) noexcept
+    : m_destroy(destroy)
+    {
+    }
+
+public:
+    FutureState(const FutureState&) = delete;
+    FutureState& operator=(const FutureState&) = delete;
+    ~FutureState()                             = default;
+
+    template <typename TAllocator>
+    static FutureState* create(const TAllocator& allocator)
+    {
+        using holder = AllocatedFutureState<T, TAllocator>;
+        typename holder::allocator_type holderAllocator(allocator);
+        auto* p = holder::allocator_traits::allocate(holderAllocator, 1);
+        try
+        {
+            ::new (static_cast<void*>(p)) holder(holderAllocator);
+        }
+        catch (...)
+        {
+            holder::allocator_traits::deallocate(holderAllocator, p, 1);
+            throw;
+        }
+        return p;
+    }
+
+    void release() noexcept
+    {
+        if ((m_state.fetch_sub(m_oneRef, std::memory_order_acq_rel) & ~(m_oneRef - 1)) == m_oneRef)
+            m_destroy(this);
+    }
+    bool is_ready() const noexcept
+    {
+        return m_state.load(std::memory_order_acquire) & m_readyFlag;
+    }
+    // Spins for spinCount rounds, then parks until the value is set.
+    void wait(int spinCount) const
+    {
+        for (int i = 0; i < spinCount; i++)
+        {
+            if (is_ready())
+                return;
+            cpuRelax();
+        }
+        auto state = m_state.load(std::memory_order_acquire);
+        while (!(state & m_readyFlag))
+        {
+            if (!(state & m_parkedFlag) &&
+                !m_state.compare_exchange_weak(state,
+                                               state | m_parkedFlag,
+                                               std::memory_order_acquire,
+                                               std::memory_order_acquire))
+                continue;
+            parkWhile(m_state, state | m_parkedFlag);
+            state = m_state.load(std::memory_order_acquire);
+        }
+    }
+
+    template <typename... TArgs>
+    void set_value(TArgs&&... args)
+    {
+        assert(!is_ready() && "value already set");
+        m_value.emplace(std::forward<TArgs>(args)...);
+        complete();
+    }
+    void set_exception(std::exception_ptr exception) noexcept
+    {
+        assert(!is_ready() && "value already set");
+        m_exception = std::move(exception);
+        complete();
+    }
+    // Only once ready.
+    value_type take()
+    {
+        if (m_exception)
+            std::rethrow_exception(m_exception);
+        return std::move(*m_value);
+    }
+
+    // Installs the continuation to run once the value is set, or runs it right away when it already
+    // is. It runs on the thread that sets the value, so it should only hand work over.
+    void set_continuation(Task<>&& continuation) noexcept
+    {
+        assert(!m_continuation.valid() && "continuation already set");
+        m_continuation = std::move(continuation);
+        auto state     = m_state.load(std::memory_order_relaxed);
+        do
+        {
+            if (state & m_readyFlag)
+            {
+                runContinuation();
+                return;
+            }
+        } while (!m_state.compare_exchange_weak(state,
+                                                state | m_continuationFlag,
+                                                std::memory_order_acq_rel,
+                                                std::memory_order_acquire));
+    }
+};
+
+// FutureState together with the allocator it came from, which it is given back to on destruction.
+template <typename T, typename TAllocator>
+class tasks::detail::AllocatedFutureState final : public FutureState<T>
+{
+public:
+    using allocator_type = typename std::allocator_traits<TAllocator>::template rebind_alloc<
+        AllocatedFutureState>;
+    using allocator_traits = std::allocator_traits<allocator_type>;
+
+private:
+    allocator_type m_allocator;
+
+    static void destroy(FutureState<T>* state) noexcept
+    {
+        auto* self     = static_cast<AllocatedFutureState*>(state);
+        auto allocator = self->m_allocator;
+        self->~AllocatedFutureState();
+        allocator_traits::deallocate(allocator, self, 1);
+    }
+
+public:
+    explicit AllocatedFutureState(const allocator_type& allocator)
+    : FutureState<T>(&destroy)
+    , m_allocator(allocator)
+    {
+    }
+};
+
+// Write side of a Future. Dropping a promise that was never fulfilled breaks it: its future
+// reports std::future_errc::broken_promise.
+template <typename T>
+class tasks::Promise final
+{
+    using state_type = detail::FutureState<T>;
+
+    state_type* m_state{nullptr};
+    bool m_futureRetrieved{false};
+
+    void release() noexcept
+    {
+        if (!m_state)
+            return;
+        if (!m_state->is_ready())
+            m_state->set_exception(
+                std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+        if (!m_futureRetrieved)
+            m_state->release();
+        m_state->release();
+        m_state = nullptr;
+    }
+
+public:
+    Promise()
+    : Promise(std::allocator_arg, std::allocator<char>())
+    {
+    }
+    template <typename TAllocator>
+    Promise(std::allocator_arg_t, const TAllocator& allocator)
+    : m_state(state_type::create(allocator))
+    {
+    }
+    Promise(Promise&& other) noexcept
+    : m_state(std::exchange(other.m_state, nullptr))
+    , m_futureRetrieved(other.m_futureRetrieved)
+    {
+    }
+    Promise& operator=(Promise&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            m_state           = std::exchange(other.m_state, nullptr);
+            m_futureRetrieved = other.m_futureRetrieved;
+        }
+        return *this;
+    }
+    Promise(const Promise&) = delete;
+    Promise& operator=(const Promise&) = delete;
+    ~Promise()
+    {
+        release();
+    }
+
+    Future<T> get_future()
+    {
+        assert(m_state && !m_futureRetrieved && "future already retrieved");
+        m_futureRetrieved = true;
+        return Future<T>(m_state);
+    }
+    template <typename... TArgs>
+    void set_value(TArgs&&... args)
+    {
+        m_state->set_value(std::forward<TArgs>(args)...);
+    }
+    void set_exception(std::exception_ptr exception) noexcept
+    {
+        m_state->set_exception(std::move(exception));
+    }
+};
+
+// Read side of a Promise, a lighter std::future: waiting spins before it parks, and then() chains
+// a continuation onto a scheduler instead of blocking a worker on get().
+template <typename T>
+class tasks::Future final
+{
+    using state_type = detail::FutureState<T>;
+
+    state_type* m_state{nullptr};
+
+    friend class Promise<T>;
+
+    explicit Future(state_type* state) noexcept
+    : m_state(state)
+    {
+    }
+    void release() noexcept
+    {
+        if (m_state)
+            std::exchange(m_state, nullptr)->release();
+    }
+
+public:
+    // Spinning only pays off when the thread setting the value runs on another CPU.
+    static int default_spin_count() noexcept
+    {
+        static const int spinCount = availableConcurrency() > 1 ? 4096 : 0;
+        return spinCount;
+    }
+
+    Future() noexcept = default;
+    Future(Future&& other) noexcept
+    : m_state(std::exchange(other.m_state, nullptr))
+    {
+    }
+    Future& operator=(Future&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            m_state = std::exchange(other.m_state, nullptr);
+        }
+        return *this;
+    }
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+    ~Future()
+    {
+        release();
+    }
+
+    bool valid() const noexcept
+    {
+        return m_state != nullptr;
+    }
+    bool is_ready() const noexcept
+    {
+        return m_state && m_state->is_ready();
+    }
+    void wait() const
+    {
+        wait(default_spin_count());
+    }
+    void wait(int spinCount) const
+    {
+        assert(valid());
+        m_state->wait(spinCount);
+    }
+    // Waits for the value and moves it out, or rethrows the stored exception. The future is no
+    // longer valid afterwards.
+    T get()
+    {
+        wait();
+        struct Releaser
+        {
+            Future& future;
+            ~Releaser()
+            {
+                future.release();
+            }
+        } releaser{*this};
+        if constexpr (std::is_void<T>::value)
+            m_state->take();
+        else
+            return m_state->take();
+    }
+
+    // Runs func() on the thread that sets the value, or right away when it already is set. Meant
+    // for short hand-overs such as when_all() and when_any(), a future takes a single one of these
+    // or a single then().
+    template <typename TCallable>
+    void on_ready(TCallable&& func)
+    {
+        assert(valid());
+        m_state->set_continuation(
+            Task<>(std::allocator_arg, std::allocator<char>(), std::forward<TCallable>(func)));
+    }
+
+    // Once the value is set, runs func(value) (func() for void) as a task spawned on scheduler, or
+    // on the thread setting the value when the queue is full, and returns the future of its result.
+    // An exception stored in this future skips func and is passed on. The continuation and its
+    // shared state are allocated from the scheduler's memory resource. Consumes this future.
+    template <typename TScheduler, typename TCallable>
+    auto then(TScheduler& scheduler, TCallable&& func) &&
+    {
+        using callable_type = std::decay_t<TCallable>;
+        using result_type   = std::conditional_t<std::is_void<T>::value,
+                                               std::invoke_result<callable_type>,
+                                               std::invoke_result<callable_type, T>>;
+        using next_type     = typename result_type::type;
+
+        assert(valid());
+        const std::pmr::polymorphic_allocator<char> allocator(scheduler.memory_resource());
+        Promise<next_type> promise(std::allocator_arg, allocator);
+        auto next   = promise.get_future();
+        auto* state = m_state;
+
+        auto body = [previous = std::move(*this),
+                     promise  = std::move(promise),
+                     func     = callable_type(std::forward<TCallable>(func))]() mutable {
+            try
+            {
+                if constexpr (std::is_void<T>::value && std::is_void<next_type>::value)
+                {
+                    previous.get();
+                    func();
+                    promise.set_value();
+                }
+                else if constexpr (std::is_void<T>::value)
+                {
+                    previous.get();
+                    promise.set_value(func());
+                }
+                else if constexpr (std::is_void<next_type>::value)
+                {
+                    std::invoke(func, previous.get());
+                    promise.set_value();
+                }
+                else
+                {
+                    promise.set_value(std::invoke(func, previous.get()));
+                }
+            }
+            catch (...)
+            {
+                promise.set_exception(std::current_exception());
+            }
+        };
+        state->set_continuation(Task<>(
+            std::allocator_arg, allocator, [&scheduler, body = std::move(body)]() mutable {
+                scheduler.spawn_or_run(std::move(body));
+            }));
+        return next;
+    }
+};
+
+namespace tasks
+{
+    namespace detail
+    {
+        template <typename T, typename TAlloc, typename TVisitor>
+        void forEachFuture(std::vector<Future<T>, TAlloc>& futures, TVisitor&& visit)
+        {
+            for (std::size_t i = 0; i < futures.size(); i++)
+                visit(i, futures[i]);
+        }
+        template <typename TTuple, typename TVisitor, std::size_t... Is>
+        void forEachFuture(TTuple& futures, TVisitor& visit, std::index_sequence<Is...>)
+        {
+            (visit(Is, std::get<Is>(futures)), ...);
+        }
+        template <typename... Ts, typename TVisitor>
+        void forEachFuture(std::tuple<Future<Ts>...>& futures, TVisitor&& visit)
+        {
+            forEachFuture(futures, visit, std::index_sequence_for<Ts...>());
+        }
+
+        // Counts down from the number of futures plus one held by the installing thread, so the
+        // futures are only moved into the result once every callback has been installed.
+        template <typename TSequence>
+        struct WhenAllState
+        {
+            std::atomic<std::size_t> remaining{0};
+            TSequence futures;
+            Promise<TSequence> promise;
+
+            WhenAllState(TSequence&& sequence, std::pmr::memory_resource* resource)
+            : futures(std::move(sequence))
+            , promise(std::allocator_arg, std::pmr::polymorphic_allocator<char>(resource))
+            {
+            }
+            void arrive()
+            {
+                if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    promise.set_value(std::move(futures));
+            }
+        };
+
+        // The first future to become ready claims the index. The result is published once that
+        // has happened and every callback has been installed, so the countdown starts at two.
+        template <typename TSequence>
+        struct WhenAnyState
+        {
+            static constexpr std::size_t none = std::size_t(-1);
+
+            std::atomic<std::size_t> index{none};
+            std::atomic<int> remaining{2};
+            TSequence futures;
+            Promise<WhenAnyResult<TSequence>> promise;
+
+            WhenAnyState(TSequence&& sequence, std::pmr::memory_resource* resource)
+            : futures(std::move(sequence))
+            , promise(std::allocator_arg, std::pmr::polymorphic_allocator<char>(resource))
+            {
+            }
+            void arrive()
+            {
+                if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    promise.set_value(WhenAnyResult<TSequence>{
+                        index.load(std::memory_order_relaxed), std::move(futures)});
+            }
+            void ready(std::size_t i)
+            {
+                auto expected = none;
+                if (index.compare_exchange_strong(expected, i, std::memory_order_acq_rel))
+                    arrive();
+            }
+        };
+
+        template <typename TSequence>
+        Future<TSequence>
+        whenAll(TSequence&& futures, std::size_t count, std::pmr::memory_resource* resource)
+        {
+            using state_type = WhenAllState<TSequence>;
+            auto state       = std::allocate_shared<state_type>(
+                std::pmr::polymorphic_allocator<state_type>(resource), std::move(futures), resource);
+            state->remaining.store(count + 1, std::memory_order_relaxed);
+            auto result = state->promise.get_future();
+            forEachFuture(state->futures, [&state](std::size_t, auto& future) {
+                future.on_ready([state]() { state->arrive(); });
+            });
+            state->arrive();
+            return result;
+        }
+        template <typename TSequence>
+        Future<WhenAnyResult<TSequence>>
+        whenAny(TSequence&& futures, std::size_t count, std::pmr::memory_resource* resource)
+        {
+            using state_type = WhenAnyState<TSequence>;
+            auto state       = std::allocate_shared<state_type>(
+                std::pmr::polymorphic_allocator<state_type>(resource), std::move(futures), resource);
+            // nothing will ever become ready, the result is published right away
+            if (count == 0)
+                state->remaining.store(1, std::memory_order_relaxed);
+            auto result = state->promise.get_future();
+            forEachFuture(state->futures, [&state](std::size_t i, auto& future) {
+                future.on_ready([state, i]() { state->ready(i); });
+            });
+            state->arrive();
+            return result;
+        }
+
+        template <typename TIterator>
+        auto moveFutures(TIterator first, TIterator last, std::pmr::memory_resource* resource)
+        {
+            using future_type = typename std::iterator_traits<TIterator>::value_type;
+            return std::pmr::vector<future_type>(
+                std::make_move_iterator(first), std::make_move_iterator(last), resource);
+        }
+    }
+
+    // Future of the futures in [first, last), which becomes ready once all of them are. A future
+    // completing costs one atomic decrement on the thread that sets it, and whoever waits for the
+    // batch is woken once. The futures come back ready in the result. Its state, the result
+    // included, is allocated from the scheduler's memory resource.
+    template <typename TScheduler,
+              typename TIterator,
+              typename = typename std::iterator_traits<TIterator>::iterator_category>
+    auto when_all(TScheduler& scheduler, TIterator first, TIterator last)
+    {
+        auto* resource   = scheduler.memory_resource();
+        auto futures     = detail::moveFutures(first, last, resource);
+        const auto count = futures.size();
+        return detail::whenAll(std::move(futures), count, resource);
+    }
+    template <typename TScheduler, typename... Ts>
+    Future<std::tuple<Future<Ts>...>> when_all(TScheduler& scheduler, Future<Ts>... futures)
+    {
+        return detail::whenAll(
+            std::make_tuple(std::move(futures)...), sizeof...(Ts), scheduler.memory_resource());
+    }
+    // Same as above, allocating from the default memory resource, with a std::vector result.
+    template <typename TIterator,
+              typename = typename std::iterator_traits<TIterator>::iterator_category>
+    auto when_all(TIterator first, TIterator last)
+    {
+        using future_type = typename std::iterator_traits<TIterator>::value_type;
+        std::vector<future_type> futures(std::make_move_iterator(first),
+                                         std::make_move_iterator(last));
+        const auto count = futures.size();
+        return detail::whenAll(std::move(futures), count, std::pmr::get_default_resource());
+    }
+    template <typename... Ts>
+    Future<std::tuple<Future<Ts>...>> when_all(Future<Ts>... futures)
+    {
+        return detail::whenAll(std::make_tuple(std::move(futures)...),
+                               sizeof...(Ts),
+                               std::pmr::get_default_resource());
+    }
+
+    // Same as above, ready as soon as one of the futures is, with its index in the result (or
+    // size_t(-1) when there is none). The other futures already carry when_any()'s callback, so
+    // they can be waited for but not chained with then().
+    template <typename TScheduler,
+              typename TIterator,
+              typename = typename std::iterator_traits<TIterator>::iterator_category>
+    auto when_any(TScheduler& scheduler, TIterator first, TIterator last)
+    {
+        auto* resource   = scheduler.memory_resource();
+        auto futures     = detail::moveFutures(first, last, resource);
+        const auto count = futures.size();
+        return detail::whenAny(std::move(futures), count, resource);
+    }
+    template <typename TScheduler, typename... Ts>
+    Future<WhenAnyResult<std::tuple<Future<Ts>...>>> when_any(TScheduler& scheduler,
+                                                              Future<Ts>... futures)
+    {
+        return detail::whenAny(
+            std::make_tuple(std::move(futures)...), sizeof...(Ts), scheduler.memory_resource());
+    }
+    template <typename TIterator,
+              typename = typename std::iterator_traits<TIterator>::iterator_category>
+    auto when_any(TIterator first, TIterator last)
+    {
+        using future_type = typename std::iterator_traits<TIterator>::value_type;
+        std::vector<future_type> futures(std::make_move_iterator(first),
+                                         std::make_move_iterator(last));
+        const auto count = futures.size();
+        return detail::whenAny(std::move(futures), count, std::pmr::get_default_resource());
+    }
+    template <typename... Ts>
+    Future<WhenAnyResult<std::tuple<Future<Ts>...>>> when_any(Future<Ts>... futures)
+    {
+        return detail::whenAny(std::make_tuple(std::move(futures)...),
+                               sizeof...(Ts),
+                               std::pmr::get_default_resource());
+    }
+}
+
+#endif // TASKS_FUTURE_H
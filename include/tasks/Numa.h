@@ -0,0 +1,29 @@
+#ifndef TASKS_NUMA_H
+#define TASKS_NUMA_H
+
+#include <string>
+#include <vector>
+
+namespace tasks
+{
+    namespace numa
+    {
+        struct Node
+        {
+            int id{0};
+            std::vector<int> cpus;
+        };
+
+        // Parses a sysfs cpu list such as "0-3,8-11".
+        std::vector<int> parseCpuList(const std::string& list);
+        // NUMA nodes from <sysfsRoot>/node<N>/cpulist, restricted to the CPUs the process may run
+        // on. Nodes without such CPUs are skipped. Without NUMA information the result is a single
+        // node holding every available CPU.
+        std::vector<Node> discoverTopology(
+            const std::string& sysfsRoot = "/sys/devices/system/node");
+        // Index into nodes of the node the calling thread currently runs on, 0 if unknown.
+        int currentNode(const std::vector<Node>& nodes);
+    }
+}
+
+#endif // TASKS_NUMA_H
@@ -0,0 +1,108 @@
+#ifndef TASKS_NUMA_SCHEDULER_H
+#define TASKS_NUMA_SCHEDULER_H
+
+#include "Numa.h"
+#include "Scheduler.h"
+#include "ThreadUtilities.h"
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace tasks
+{
+    template <typename TTaskQueue>
+    class NumaScheduler;
+}
+
+// One queue, one memory pool and one Scheduler per NUMA node. Queue and pool are created and
+// prefaulted by a thread running on their node, so they live in that node's memory, and the
+// node's workers are pinned to its CPUs. Workers take tasks from other nodes' queues only when
+// their own node has nothing left to run.
+template <typename TTaskQueue>
+class tasks::NumaScheduler
+{
+    using memory_pool_type = typename TTaskQueue::memory_pool_type;
+    using scheduler_type   = Scheduler<TTaskQueue>;
+
+    struct Node
+    {
+        numa::Node topology;
+        std::unique_ptr<memory_pool_type> pool;
+        std::unique_ptr<TTaskQueue> queue;
+        std::unique_ptr<scheduler_type> scheduler;
+    };
+
+    std::vector<numa::Node> m_topology;
+    std::vector<Node> m_nodes;
+
+public:
+    // config.threadCount is per node, <= 0 meaning one worker per CPU of the node. config.affinity
+    // and config.cpus are overridden by the node's CPUs.
+    explicit NumaScheduler(const SchedulerConfig& config = SchedulerConfig{},
+                           std::vector<numa::Node> topology = numa::discoverTopology())
+    : m_topology(std::move(topology))
+    , m_nodes(m_topology.size())
+    {
+        for (size_t i = 0; i < m_nodes.size(); i++)
+        {
+            auto& node    = m_nodes[i];
+            node.topology = m_topology[i];
+            std::thread([&node]() {
+                setThreadAffinity(nullptr, node.topology.cpus);
+                node.pool = std::make_unique<memory_pool_type>();
+                node.pool->prefault();
+                node.queue = std::make_unique<TTaskQueue>(*node.pool);
+            })
+                .join();
+        }
+        for (size_t i = 0; i < m_nodes.size(); i++)
+        {
+            auto& node = m_nodes[i];
+            std::vector<TTaskQueue*> remoteQueues;
+            for (size_t j = 1; j < m_nodes.size(); j++)
+                remoteQueues.push_back(m_nodes[(i + j) % m_nodes.size()].queue.get());
+
+            auto nodeConfig        = config;
+            nodeConfig.affinity    = CpuAffinity::Explicit;
+            nodeConfig.cpus        = node.topology.cpus;
+            nodeConfig.threadCount = config.threadCount > 0
+                                         ? std::min<int>(config.threadCount,
+                                                         int(node.topology.cpus.size()))
+                                         : int(node.topology.cpus.size());
+            node.scheduler =
+                std::make_unique<scheduler_type>(*node.queue, nodeConfig, std::move(remoteQueues));
+        }
+    }
+    NumaScheduler(const NumaScheduler&) = delete;
+    NumaScheduler& operator=(const NumaScheduler&) = delete;
+    ~NumaScheduler()
+    {
+        // stop every worker before any queue they might steal from goes away
+        for (auto& node : m_nodes)
+            node.scheduler.reset();
+    }
+
+    size_t nodeCount() const noexcept
+    {
+        return m_nodes.size();
+    }
+    const numa::Node& node(size_t index) const noexcept
+    {
+        return m_nodes[index].topology;
+    }
+    TTaskQueue& queue(size_t index) noexcept
+    {
+        return *m_nodes[index].queue;
+    }
+    scheduler_type& scheduler(size_t index) noexcept
+    {
+        return *m_nodes[index].scheduler;
+    }
+    // Queue of the node the calling thread runs on, submitting there keeps tasks node local.
+    TTaskQueue& localQueue() noexcept
+    {
+        return queue(size_t(numa::currentNode(m_topology)));
+    }
+};
+
+#endif // TASKS_NUMA_SCHEDULER_H
@@ -0,0 +1,50 @@
+#ifndef TASKS_PAGES_H
+#define TASKS_PAGES_H
+
+#include <cstddef>
+
+namespace tasks
+{
+    namespace memory
+    {
+        struct PageOptions
+        {
+            bool hugePages{false}; // MAP_HUGETLB, falling back to transparent huge pages
+            bool populate{false};  // fault every page in before returning
+            bool lock{false};      // mlock, so pages are never swapped out
+
+            // Everything a realtime thread wants from its memory.
+            static constexpr PageOptions realtime() noexcept
+            {
+                return PageOptions{true, true, true};
+            }
+        };
+
+        // What a mapping actually got, each option may fail on its own: huge pages need reserved
+        // pages or THP support, mlock is bounded by RLIMIT_MEMLOCK.
+        struct Mapping
+        {
+            void* data{nullptr};
+            std::size_t bytes{0}; // mapped length, rounded up to whole (huge) pages
+            bool hugePages{false};
+            bool transparentHugePages{false};
+            bool populated{false};
+            bool locked{false};
+        };
+
+        // Size of a virtual memory page.
+        std::size_t pageSize() noexcept;
+        // Size of an explicit huge page, 0 if unknown.
+        std::size_t hugePageSize() noexcept;
+        // Maps bytes (rounded up to whole pages) of zeroed, page aligned anonymous memory straight
+        // from the OS, bypassing the global heap. Returns nullptr on failure.
+        void* mapPages(std::size_t bytes) noexcept;
+        // Releases memory obtained from mapPages with the same byte count.
+        void unmapPages(void* p, std::size_t bytes) noexcept;
+        // Same as above, honouring options as far as the system allows. data is nullptr on failure.
+        Mapping mapPages(std::size_t bytes, const PageOptions& options) noexcept;
+        void unmapPages(const Mapping& mapping) noexcept;
+    }
+}
+
+#endif // TASKS_PAGES_H
@@ -0,0 +1,53 @@
+#ifndef TASKS_POOL_RESOURCE_H
+#define TASKS_POOL_RESOURCE_H
+
+#include "Allocator.h"
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+
+namespace tasks
+{
+    namespace memory
+    {
+        template <typename TMemoryPool>
+        class PoolResource;
+    }
+}
+
+// std::pmr::memory_resource over any pool kind, so std::pmr containers built inside tasks draw from
+// the same bounded memory as the tasks themselves. Requests aligned beyond the pool alignment throw
+// std::bad_alloc. The pool must outlive the resource and everything allocated from it.
+template <typename TMemoryPool>
+class tasks::memory::PoolResource final : public std::pmr::memory_resource
+{
+    static constexpr std::size_t m_alignment{detail::PoolAlignment<TMemoryPool>::value};
+    TMemoryPool& m_pool;
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        if (alignment > m_alignment)
+            throw std::bad_alloc();
+        return m_pool.template allocate<m_alignment>(bytes);
+    }
+    void do_deallocate(void* p, std::size_t bytes, std::size_t) override
+    {
+        m_pool.deallocate(static_cast<char*>(p), bytes);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+public:
+    explicit PoolResource(TMemoryPool& pool) noexcept
+    : m_pool(pool)
+    {
+    }
+    TMemoryPool& pool() const noexcept
+    {
+        return m_pool;
+    }
+};
+
+#endif // TASKS_POOL_RESOURCE_H
@@ -2,17 +2,32 @@
 #define TASKS_THREADSAFE_QUEUE_H
 
 #include "Allocator.h"
+#include "CompletionCounter.h"
+#include "EventCount.h"
+#include "Ring.h"
+#include "Task.h"
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <cassert>
 #include <future>
+#include <iterator>
+#include <memory>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace tasks
 {
     namespace threadsafe
     {
-        template <typename TCallableReturnType, int64_t TMaxSize, size_t TMemoryPoolSize>
+        template <typename TCallableReturnType,
+                  int64_t TMaxSize,
+                  size_t TMemoryPoolSize,
+                  template <typename, int64_t> class TRing               = SharedCounterRing,
+                  size_t TInlineTaskSize                                 = 48,
+                  template <std::size_t, std::size_t> class TMemoryPool = memory::MemoryPool>
         class Queue;
     }
 
@@ -22,29 +37,240 @@ namespace tasks
         constexpr static bool value = (N > 0) && (N & (N - 1)) == 0;
     };
 
+    namespace detail
+    {
+        // Decayed callable plus decayed arguments, invoked once with the arguments moved into the
+        // call: move-only arguments are accepted and large ones are handed over without a copy.
+        template <typename TCallable, typename... Args>
+        struct BoundCall
+        {
+            TCallable func;
+            std::tuple<Args...> args;
+
+            decltype(auto) operator()()
+            {
+                return std::apply(std::move(func), std::move(args));
+            }
+        };
+
+        // No wrapper at all when there is nothing to bind.
+        template <typename TCallable, typename... Args>
+        auto bindCall(TCallable&& func, Args&&... args)
+        {
+            if constexpr (sizeof...(Args) == 0)
+                return std::decay_t<TCallable>(std::forward<TCallable>(func));
+            else
+                return BoundCall<std::decay_t<TCallable>, std::decay_t<Args>...>{
+                    std::forward<TCallable>(func), {std::forward<Args>(args)...}};
+        }
+
+        // Pools that count tasks against epochs, see EpochMemoryPool::pin().
+        template <typename TPool, typename = void>
+        struct HasEpochs : std::false_type
+        {
+        };
+        template <typename TPool>
+        struct HasEpochs<TPool, std::void_t<decltype(std::declval<TPool&>().pin())>>
+        : std::true_type
+        {
+        };
+
+        // What the task built from func and args returns.
+        template <typename TCallable, typename... Args>
+        using call_result_t = std::invoke_result_t<std::decay_t<TCallable>, std::decay_t<Args>...>;
+
+        // for std::promise as well as tasks::Promise
+        template <template <typename> class TPromise, typename TResult, typename TCallable>
+        void fulfil(TPromise<TResult>& promise, TCallable& func)
+        {
+            try
+            {
+                if constexpr (std::is_void<TResult>::value)
+                {
+                    func();
+                    promise.set_value();
+                }
+                else
+                {
+                    promise.set_value(func());
+                }
+            }
+            catch (...)
+            {
+                promise.set_exception(std::current_exception());
+            }
+        }
+    }
 }
 
-template <typename TCallableReturnType, int64_t TMaxSize, size_t TMemoryPoolSize>
+template <typename TCallableReturnType,
+          int64_t TMaxSize,
+          size_t TMemoryPoolSize,
+          template <typename, int64_t> class TRing,
+          size_t TInlineTaskSize,
+          template <std::size_t, std::size_t> class TMemoryPool>
 class tasks::threadsafe::Queue final
 {
-    using task_type   = std::packaged_task<TCallableReturnType()>;
-    using future_type = std::future<TCallableReturnType>;
+public:
+    using task_type        = Task<TInlineTaskSize>;
+    using task_return_type = TCallableReturnType;
+    using allocator_type = memory::
+        AllocatorWithInternalMemory<void, TMemoryPoolSize, alignof(std::max_align_t), TMemoryPool>;
+    using memory_pool_type = typename allocator_type::memory_pool_type;
+    static constexpr int64_t max_batch_size = 32;
+    // With a pool that has epochs, every task pins the epoch it is submitted in until it has run,
+    // so an epoch only becomes quiescent once its tasks are done, inline ones included.
+    static constexpr bool pins_epochs = detail::HasEpochs<memory_pool_type>::value;
 
-    std::atomic<int64_t> m_readIdx{0};
-    std::atomic<int64_t> m_read{0};
-    alignas(64) char m_padToAvoidFalseSharing[64 - 2 * sizeof(int64_t)];
-    std::atomic<int64_t> m_writeIdx{0};
-    std::atomic<int64_t> m_written{0};
-    alignas(64) char m_padToAvoidFalseSharing2[64 - 2 * sizeof(int64_t)];
+private:
+    using future_type  = std::future<TCallableReturnType>;
+    using ring_type    = TRing<task_type, TMaxSize>;
 
-    memory::Allocator<void, TMemoryPoolSize> m_allocator;
-    std::vector<task_type> m_buffer;
-    static constexpr size_t m_bitmask{TMaxSize - 1};
+    // null when the pool is borrowed
+    std::unique_ptr<memory_pool_type> m_pool;
+    allocator_type m_allocator;
+    ring_type m_ring;
+    EventCount m_notEmpty;
+    struct NoEpochs
+    {
+    };
+    // epoch pinned by the task of each slot
+    std::conditional_t<pins_epochs, std::array<uint64_t, TMaxSize>, NoEpochs> m_epochs;
+
+    void pin_slot([[maybe_unused]] int64_t idx) noexcept
+    {
+        if constexpr (pins_epochs)
+            m_epochs[idx & (TMaxSize - 1)] = m_allocator.pool().pin();
+    }
+    // to be read before the slot is published back to the producers
+    uint64_t slot_epoch([[maybe_unused]] int64_t idx) const noexcept
+    {
+        if constexpr (pins_epochs)
+            return m_epochs[idx & (TMaxSize - 1)];
+        else
+            return 0;
+    }
+    void unpin([[maybe_unused]] uint64_t epoch) noexcept
+    {
+        if constexpr (pins_epochs)
+            m_allocator.pool().unpin(epoch);
+    }
+
+    bool push(task_type&& task)
+    {
+        if (!try_write(std::move(task)))
+        {
+            // buffer is full
+            assert(false);
+            return false;
+        }
+        return true;
+    }
+    // Same as push() for callers that handle a full queue themselves, task is left untouched then.
+    bool try_write(task_type&& task)
+    {
+        int64_t wIdx = 0;
+        if (!m_ring.try_claim_write(wIdx))
+            return false;
+
+        pin_slot(wIdx);
+        m_ring.slot(wIdx) = std::move(task);
+        m_ring.publish_write(wIdx);
+        m_notEmpty.notify_one();
+        return true;
+    }
+    // Claims n consecutive slots with a single atomic operation, fills slot i with makeTask(i) and
+    // publishes the whole block at once. All or nothing: returns false when the ring has no room
+    // for the whole block, and when makeTask throws none of the block's tasks runs.
+    template <typename TTaskFactory>
+    bool push_n(int64_t n, TTaskFactory&& makeTask)
+    {
+        if (n <= 0)
+            return true;
+
+        int64_t first = 0;
+        if (!m_ring.try_claim_write_n(n, first))
+            return false;
+        // every published slot is unpinned by its consumer, empty ones as well
+        for (int64_t i = 0; i < n; i++)
+            pin_slot(first + i);
+
+        try
+        {
+            for (int64_t i = 0; i < n; i++)
+            {
+                m_ring.slot(first + i) = makeTask(i);
+            }
+        }
+        catch (...)
+        {
+            // claimed slots have to be published anyway, publish them all empty
+            for (int64_t i = 0; i < n; i++)
+            {
+                m_ring.slot(first + i) = task_type{};
+            }
+            m_ring.publish_write_n(first, n);
+            throw;
+        }
+        m_ring.publish_write_n(first, n);
+        m_notEmpty.notify(n);
+        return true;
+    }
+    // push_n() for tasks that decrement counter once they have run, counter is incremented for the
+    // whole block and restored when the block is not enqueued.
+    template <typename TTaskFactory>
+    bool push_n(CompletionCounter& counter, int64_t n, TTaskFactory&& makeTask)
+    {
+        counter.increment(n);
+        try
+        {
+            if (push_n(n, std::forward<TTaskFactory>(makeTask)))
+                return true;
+        }
+        catch (...)
+        {
+            counter.decrement(n);
+            throw;
+        }
+        counter.decrement(n);
+        return false;
+    }
+
+    template <typename TResult, typename TCallable, typename... Args>
+    std::pair<task_type, std::future<TResult>> make_future_task_as(TCallable&& func, Args&&... args)
+    {
+        auto promise = std::promise<TResult>(std::allocator_arg, m_allocator);
+        auto future  = promise.get_future();
+        auto task    = task_type(
+            std::allocator_arg,
+            m_allocator,
+            [promise = std::move(promise),
+             callable = detail::bindCall(std::forward<TCallable>(func),
+                                         std::forward<Args>(args)...)]() mutable {
+                detail::fulfil(promise, callable);
+            });
+        return {std::move(task), std::move(future)};
+    }
 
 public:
-    using task_return_type = TCallableReturnType;
+    // The queue owns a pool of TMemoryPoolSize bytes. Its tasks and futures only borrow it, so
+    // futures must not outlive the queue.
     Queue() noexcept(false)
-    : m_buffer(TMaxSize)
+    : Queue(std::in_place)
+    {
+    }
+    // Forwards args to the constructor of the owned pool, e.g. a size chosen at runtime.
+    template <typename... TArgs>
+    explicit Queue(std::in_place_t, TArgs&&... args) noexcept(false)
+    : m_pool(std::make_unique<memory_pool_type>(std::forward<TArgs>(args)...))
+    , m_allocator(*m_pool)
+    {
+        static_assert(IsPowerOfTwo<TMaxSize>::value, "Queue max size must be a power of two");
+    }
+    // Allocates from a borrowed pool, e.g. one shared with other queues, which must outlive the
+    // queue and all of its futures.
+    explicit Queue(memory_pool_type& pool) noexcept(false)
+    : m_allocator(pool)
     {
         static_assert(IsPowerOfTwo<TMaxSize>::value, "Queue max size must be a power of two");
     }
@@ -56,65 +282,183 @@ public:
 
     bool try_call_next()
     {
-        auto rIdx       = m_read.load(std::memory_order_acquire);
-        const auto wIdx = m_written.load(std::memory_order_acquire);
-
-        if (rIdx >= wIdx)
+        int64_t rIdx = 0;
+        if (!m_ring.try_claim_read(rIdx))
             return false;
 
-        while (!m_readIdx.compare_exchange_weak(
-            rIdx, rIdx + 1, std::memory_order_release, std::memory_order_relaxed))
-        {
-            if (rIdx >= wIdx)
-                return false;
-        }
-        if (rIdx >= wIdx)
-            return false;
-
-        auto& x = m_buffer[rIdx & m_bitmask];
-        if (x.valid())
-            x();
-        m_read.fetch_add(1, std::memory_order_release);
+        // the task leaves its slot before the read is published, so a long or blocking task never
+        // holds back the consumers behind it; it is run and destroyed by this consumer, so shared
+        // states and captures are released on the core that used them last
+        auto task        = std::move(m_ring.slot(rIdx));
+        const auto epoch = slot_epoch(rIdx);
+        m_ring.publish_read(rIdx);
+        if (task.valid())
+            task();
+        unpin(epoch);
         return true;
     }
-    template <typename TCallable, typename... Args>
-    future_type try_push(TCallable&& func, Args&&... args)
+    // Claims up to maxCount (at most max_batch_size) consecutive tasks with a single atomic
+    // operation and runs them back to back. Returns the number of tasks run.
+    int64_t try_call_next_n(int64_t maxCount)
     {
-        auto task =
-            task_type(std::allocator_arg,
-                      m_allocator,
-                      std::bind(std::forward<TCallable>(func), std::forward<Args>(args)...));
-        auto future = task.get_future();
-
-        auto wIdx       = m_written.load(std::memory_order_acquire);
-        const auto rIdx = m_read.load(std::memory_order_acquire);
-
-        if (wIdx - rIdx >= TMaxSize - 1)
+        return try_call_next_n(maxCount, []() {});
+    }
+    // Same as above, calling afterEach() once each task has run.
+    template <typename TAfterEach>
+    int64_t try_call_next_n(int64_t maxCount, TAfterEach&& afterEach)
+    {
+        task_type batch[max_batch_size];
+        uint64_t epochs[max_batch_size];
+        int64_t first = 0;
+        const auto n  = m_ring.try_claim_read_n(std::min(maxCount, max_batch_size), first);
+        for (int64_t i = 0; i < n; i++)
         {
-            // buffer is full
-            assert(false);
-            return future_type{};
+            batch[i]  = std::move(m_ring.slot(first + i));
+            epochs[i] = slot_epoch(first + i);
         }
-
-        while (!m_writeIdx.compare_exchange_weak(
-            wIdx, wIdx + 1, std::memory_order_release, std::memory_order_relaxed))
+        if (n > 0)
+            m_ring.publish_read_n(first, n);
+        for (int64_t i = 0; i < n; i++)
         {
-            if (wIdx - rIdx >= TMaxSize - 1)
-            {
-                assert(false);
-                return future_type{};
-            }
+            if (batch[i].valid())
+                batch[i]();
+            unpin(epochs[i]);
+            afterEach();
         }
-
-        if (wIdx - rIdx >= TMaxSize - 1)
-        {
-            assert(false);
+        // tasks of a batch run back to back, their destruction comes after the whole batch
+        return n;
+    }
+    // Submission with a future of the queue's return type, the callable's result is converted to it
+    // (or dropped for void). Returns an invalid future when the queue is full.
+    template <typename TCallable, typename... Args>
+    future_type try_push(TCallable&& func, Args&&... args)
+    {
+        auto [task, future] = make_future_task_as<TCallableReturnType>(
+            std::forward<TCallable>(func), std::forward<Args>(args)...);
+        if (!push(std::move(task)))
             return future_type{};
-        }
-
-        m_buffer[wIdx & m_bitmask] = std::move(task);
-        m_written.fetch_add(1, std::memory_order_release);
-        return future;
+        return std::move(future);
+    }
+    // Submission with a future of whatever func(args...) returns, so callables of any return type
+    // share one queue. Returns an invalid future when the queue is full.
+    template <typename TCallable, typename... Args>
+    auto try_submit(TCallable&& func, Args&&... args)
+    {
+        using result_type = detail::call_result_t<TCallable, Args...>;
+        auto [task, future] = make_future_task_as<result_type>(std::forward<TCallable>(func),
+                                                                std::forward<Args>(args)...);
+        if (!push(std::move(task)))
+            return std::future<result_type>{};
+        return std::move(future);
+    }
+    // Fire-and-forget submission: no promise or future is created, so tasks whose bound callable
+    // fits the inline buffer cost a single ring slot write. The callable must not throw.
+    template <typename TCallable, typename... Args>
+    bool try_post(TCallable&& func, Args&&... args)
+    {
+        return push(make_task(std::forward<TCallable>(func), std::forward<Args>(args)...));
+    }
+    // Same as above; counter is incremented on submission and decremented once the task has run.
+    template <typename TCallable, typename... Args>
+    bool try_post(CompletionCounter& counter, TCallable&& func, Args&&... args)
+    {
+        counter.increment();
+        const bool pushed =
+            push(make_task(counter, std::forward<TCallable>(func), std::forward<Args>(args)...));
+        if (!pushed)
+            counter.decrement();
+        return pushed;
+    }
+    // Bulk fire-and-forget submission of every callable in [first, last). Either all of them are
+    // enqueued or none is: when the queue has no room for the whole range (false is returned), or
+    // when copying a callable throws.
+    template <typename TIterator>
+    bool try_post_bulk(TIterator first, TIterator last)
+    {
+        return push_n(std::distance(first, last), [this, &first](int64_t) {
+            return task_type(std::allocator_arg, m_allocator, *first++);
+        });
+    }
+    template <typename TIterator>
+    bool try_post_bulk(CompletionCounter& counter, TIterator first, TIterator last)
+    {
+        return push_n(counter, std::distance(first, last), [this, &first, &counter](int64_t) {
+            return task_type(std::allocator_arg,
+                             m_allocator,
+                             [&counter, callable = *first++]() mutable {
+                                 callable();
+                                 counter.decrement();
+                             });
+        });
+    }
+    // Enqueues n tasks, task i calls func(i).
+    template <typename TCallable>
+    bool try_post_n(int64_t n, const TCallable& func)
+    {
+        return push_n(n, [this, &func](int64_t i) {
+            return task_type(std::allocator_arg, m_allocator, [func, i]() { func(i); });
+        });
+    }
+    template <typename TCallable>
+    bool try_post_n(CompletionCounter& counter, int64_t n, const TCallable& func)
+    {
+        return push_n(counter, n, [this, &counter, &func](int64_t i) {
+            return task_type(std::allocator_arg, m_allocator, [&counter, func, i]() {
+                func(i);
+                counter.decrement();
+            });
+        });
+    }
+    // Enqueues a task built with make_task(). Returns false, leaving task untouched, when the queue
+    // is full: unlike the other submissions this does not assert, the caller is expected to deal
+    // with it, e.g. by running the task itself.
+    bool try_post_task(task_type&& task)
+    {
+        return try_write(std::move(task));
+    }
+    // Builds a fire-and-forget task using this queue's memory pool, e.g. to be run elsewhere.
+    template <typename TCallable, typename... Args>
+    task_type make_task(TCallable&& func, Args&&... args)
+    {
+        return task_type(
+            std::allocator_arg,
+            m_allocator,
+            detail::bindCall(std::forward<TCallable>(func), std::forward<Args>(args)...));
+    }
+    // Same as above, the task decrements counter once it has run. The caller increments it.
+    template <typename TCallable, typename... Args>
+    task_type make_task(CompletionCounter& counter, TCallable&& func, Args&&... args)
+    {
+        return task_type(
+            std::allocator_arg,
+            m_allocator,
+            [&counter,
+             callable = detail::bindCall(std::forward<TCallable>(func),
+                                         std::forward<Args>(args)...)]() mutable {
+                callable();
+                counter.decrement();
+            });
+    }
+    // Builds a task, using this queue's memory pool, together with the future it fulfils with the
+    // result of func(args...), e.g. to be run elsewhere.
+    template <typename TCallable, typename... Args>
+    auto make_future_task(TCallable&& func, Args&&... args)
+    {
+        return make_future_task_as<detail::call_result_t<TCallable, Args...>>(
+            std::forward<TCallable>(func), std::forward<Args>(args)...);
+    }
+    int64_t size() const noexcept
+    {
+        return m_ring.size();
+    }
+    memory_pool_type& memory_pool() const noexcept
+    {
+        return m_allocator.pool();
+    }
+    // Signalled after every submission, consumers may park on it while the queue is empty.
+    EventCount& not_empty() noexcept
+    {
+        return m_notEmpty;
     }
 };
 
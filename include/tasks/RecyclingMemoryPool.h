@@ -0,0 +1,140 @@
+#ifndef TASKS_RECYCLING_MEMORY_POOL_H
+#define TASKS_RECYCLING_MEMORY_POOL_H
+
+#include "Allocator.h"
+#include "FreeList.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace tasks
+{
+    namespace memory
+    {
+        template <typename TMemoryPool, std::size_t TBlockSize, std::size_t TBlockCount>
+        class RecyclingMemoryPool;
+
+        // Pool kind adaptor putting a RecyclingMemoryPool in front of TPool, e.g.
+        // Queue<..., Recycling<MemoryPool>::type>.
+        template <template <std::size_t, std::size_t> class TPool,
+                  std::size_t TBlockSize  = 128,
+                  std::size_t TBlockCount = 1024>
+        struct Recycling
+        {
+            template <std::size_t N, std::size_t alignment>
+            using type = RecyclingMemoryPool<TPool<N, alignment>, TBlockSize, TBlockCount>;
+        };
+    }
+}
+
+// Pool caching TBlockCount blocks of TBlockSize bytes in front of another pool. Small requests,
+// which are the promise/future shared states and out of line tasks of every submission, are served
+// from a lock-free free list of blocks that were released before, so steady state submission keeps
+// cycling through the same few warm blocks and never reaches the pool behind. Larger requests, and
+// small ones once every block is taken, go to that pool.
+template <typename TMemoryPool, std::size_t TBlockSize, std::size_t TBlockCount>
+class tasks::memory::RecyclingMemoryPool
+{
+public:
+    static constexpr std::size_t pool_alignment = detail::PoolAlignment<TMemoryPool>::value;
+    static constexpr std::size_t block_size =
+        (TBlockSize + (pool_alignment - 1)) & ~(pool_alignment - 1);
+    static constexpr std::size_t block_count = TBlockCount;
+
+private:
+    alignas(pool_alignment) char m_blocks[block_count * block_size];
+    detail::FreeList m_freeList;
+    std::atomic<uint32_t> m_carved{0};
+    TMemoryPool m_pool;
+
+    bool isBlock(const char* p) const noexcept
+    {
+        return m_blocks <= p && p < m_blocks + sizeof(m_blocks);
+    }
+    char* pop() noexcept
+    {
+        if (char* block = m_freeList.pop(m_blocks, block_size))
+            return block;
+        // never used blocks come last
+        auto carved = m_carved.load(std::memory_order_relaxed);
+        do
+        {
+            if (carved == block_count)
+                return nullptr;
+        } while (!m_carved.compare_exchange_weak(
+            carved, carved + 1, std::memory_order_relaxed, std::memory_order_relaxed));
+        return m_blocks + std::size_t(carved) * block_size;
+    }
+
+public:
+    // Forwards args to the constructor of the pool behind.
+    template <typename... TArgs>
+    explicit RecyclingMemoryPool(TArgs&&... args)
+    : m_pool(std::forward<TArgs>(args)...)
+    {
+        static_assert(block_size >= sizeof(uint32_t), "blocks must fit a free list link");
+        static_assert(block_count < (std::size_t(1) << 32) - 1, "too many blocks");
+    }
+    RecyclingMemoryPool(const RecyclingMemoryPool&) = delete;
+    RecyclingMemoryPool& operator=(const RecyclingMemoryPool&) = delete;
+    ~RecyclingMemoryPool()                                     = default;
+
+    template <std::size_t ReqAlign>
+    char* allocate(std::size_t n)
+    {
+        static_assert(ReqAlign <= pool_alignment, "alignment is too small for this memory pool");
+        if (n <= block_size)
+        {
+            if (char* r = pop())
+                return r;
+        }
+        return m_pool.template allocate<ReqAlign>(n);
+    }
+    void deallocate(char* p, std::size_t n) noexcept
+    {
+        if (isBlock(p))
+            m_freeList.push(m_blocks, block_size, p);
+        else
+            m_pool.deallocate(p, n);
+    }
+
+    std::size_t size() const noexcept
+    {
+        return sizeof(m_blocks) + m_pool.size();
+    }
+    bool owns(const char* p) const noexcept
+    {
+        return isBlock(p) || m_pool.owns(p);
+    }
+    // bytes in use from the pool behind, the cached blocks excluded
+    std::size_t used() const noexcept
+    {
+        return m_pool.used();
+    }
+    // number of cached blocks handed out at least once
+    std::size_t blocks_touched() const noexcept
+    {
+        return m_carved.load(std::memory_order_relaxed);
+    }
+    TMemoryPool& pool() noexcept
+    {
+        return m_pool;
+    }
+    // Only safe once no block of the pool is in use anymore.
+    void reset() noexcept
+    {
+        m_freeList.clear();
+        m_carved.store(0, std::memory_order_release);
+        m_pool.reset();
+    }
+    void prefault() noexcept
+    {
+        std::memset(m_blocks, 0, sizeof(m_blocks));
+        m_pool.prefault();
+    }
+};
+
+#endif // TASKS_RECYCLING_MEMORY_POOL_H
@@ -0,0 +1,313 @@
+#ifndef TASKS_RING_H
+#define TASKS_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace tasks
+{
+    namespace threadsafe
+    {
+        template <typename T, int64_t TSize>
+        class SharedCounterRing;
+        template <typename T, int64_t TSize>
+        class SequencedRing;
+    }
+}
+
+// Slot storage for threadsafe::Queue. A ring hands out slot indices to producers and consumers:
+//   try_claim_write(idx) -> write slot(idx) -> publish_write(idx)
+//   try_claim_read(idx)  -> use slot(idx)   -> publish_read(idx)
+// The _n variants do the same for a block of consecutive slots with one atomic claim.
+
+// Ring tracked by four global counters. A claimed slot only becomes visible once every earlier
+// claim has been published, so publication happens strictly in claim order.
+template <typename T, int64_t TSize>
+class tasks::threadsafe::SharedCounterRing final
+{
+    std::atomic<int64_t> m_readIdx{0};
+    std::atomic<int64_t> m_read{0};
+    alignas(64) char m_padToAvoidFalseSharing[64 - 2 * sizeof(int64_t)];
+    std::atomic<int64_t> m_writeIdx{0};
+    std::atomic<int64_t> m_written{0};
+    alignas(64) char m_padToAvoidFalseSharing2[64 - 2 * sizeof(int64_t)];
+
+    std::vector<T> m_buffer;
+    static constexpr int64_t m_bitmask{TSize - 1};
+
+    static void waitUntilEqual(const std::atomic<int64_t>& counter, int64_t value)
+    {
+        while (counter.load(std::memory_order_acquire) != value)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+public:
+    static constexpr int64_t capacity = TSize - 1;
+
+    SharedCounterRing() noexcept(false)
+    : m_buffer(TSize)
+    {
+    }
+
+    bool try_claim_write(int64_t& idx)
+    {
+        return try_claim_write_n(1, idx);
+    }
+    bool try_claim_write_n(int64_t n, int64_t& first)
+    {
+        auto wIdx       = m_writeIdx.load(std::memory_order_relaxed);
+        const auto rIdx = m_read.load(std::memory_order_acquire);
+        do
+        {
+            if (wIdx + n - rIdx > capacity)
+                return false;
+        } while (!m_writeIdx.compare_exchange_weak(
+            wIdx, wIdx + n, std::memory_order_acquire, std::memory_order_relaxed));
+        first = wIdx;
+        return true;
+    }
+    void publish_write(int64_t idx)
+    {
+        publish_write_n(idx, 1);
+    }
+    void publish_write_n(int64_t first, int64_t n)
+    {
+        waitUntilEqual(m_written, first);
+        m_written.store(first + n, std::memory_order_release);
+    }
+    bool try_claim_read(int64_t& idx)
+    {
+        auto rIdx       = m_readIdx.load(std::memory_order_relaxed);
+        const auto wIdx = m_written.load(std::memory_order_acquire);
+        do
+        {
+            if (rIdx >= wIdx)
+                return false;
+        } while (!m_readIdx.compare_exchange_weak(
+            rIdx, rIdx + 1, std::memory_order_acquire, std::memory_order_relaxed));
+        idx = rIdx;
+        return true;
+    }
+    int64_t try_claim_read_n(int64_t maxCount, int64_t& first)
+    {
+        auto rIdx       = m_readIdx.load(std::memory_order_relaxed);
+        const auto wIdx = m_written.load(std::memory_order_acquire);
+        int64_t n       = 0;
+        do
+        {
+            n = std::min(maxCount, wIdx - rIdx);
+            if (n <= 0)
+                return 0;
+        } while (!m_readIdx.compare_exchange_weak(
+            rIdx, rIdx + n, std::memory_order_acquire, std::memory_order_relaxed));
+        first = rIdx;
+        return n;
+    }
+    void publish_read(int64_t idx)
+    {
+        publish_read_n(idx, 1);
+    }
+    void publish_read_n(int64_t first, int64_t n)
+    {
+        waitUntilEqual(m_read, first);
+        m_read.store(first + n, std::memory_order_release);
+    }
+    T& slot(int64_t idx) noexcept
+    {
+        return m_buffer[idx & m_bitmask];
+    }
+    int64_t size() const noexcept
+    {
+        return m_written.load(std::memory_order_relaxed) - m_read.load(std::memory_order_relaxed);
+    }
+};
+
+// Bounded MPMC ring where every slot carries its own sequence number (D. Vyukov's design).
+// Producers and consumers only contend on claiming a position; publication touches the slot alone,
+// so a descheduled thread never blocks the threads behind it.
+template <typename T, int64_t TSize>
+class tasks::threadsafe::SequencedRing final
+{
+    struct Cell
+    {
+        std::atomic<int64_t> sequence{0};
+        T value{};
+    };
+
+    alignas(64) std::atomic<int64_t> m_enqueuePos{0};
+    alignas(64) std::atomic<int64_t> m_dequeuePos{0};
+    alignas(64) std::vector<Cell> m_cells;
+    static constexpr int64_t m_bitmask{TSize - 1};
+
+    Cell& cell(int64_t idx) noexcept
+    {
+        return m_cells[idx & m_bitmask];
+    }
+
+public:
+    static constexpr int64_t capacity = TSize;
+
+    SequencedRing() noexcept(false)
+    : m_cells(TSize)
+    {
+        for (int64_t i = 0; i < TSize; i++)
+        {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool try_claim_write(int64_t& idx)
+    {
+        auto pos = m_enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            const auto seq  = cell(pos).sequence.load(std::memory_order_acquire);
+            const auto diff = seq - pos;
+            if (diff == 0)
+            {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                // buffer is full
+                return false;
+            }
+            else
+            {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        idx = pos;
+        return true;
+    }
+    bool try_claim_write_n(int64_t n, int64_t& first)
+    {
+        if (n > TSize)
+            return false;
+        auto pos = m_enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            // every slot of the block must have been released by its previous consumer
+            int64_t i = 0;
+            for (; i < n; i++)
+            {
+                const auto seq = cell(pos + i).sequence.load(std::memory_order_acquire);
+                if (seq != pos + i)
+                    break;
+            }
+            if (i == n)
+            {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed))
+                    break;
+            }
+            else
+            {
+                const auto current = m_enqueuePos.load(std::memory_order_relaxed);
+                if (current == pos)
+                {
+                    // buffer is full
+                    return false;
+                }
+                pos = current;
+            }
+        }
+        first = pos;
+        return true;
+    }
+    void publish_write(int64_t idx)
+    {
+        cell(idx).sequence.store(idx + 1, std::memory_order_release);
+    }
+    void publish_write_n(int64_t first, int64_t n)
+    {
+        for (int64_t i = 0; i < n; i++)
+        {
+            publish_write(first + i);
+        }
+    }
+    bool try_claim_read(int64_t& idx)
+    {
+        auto pos = m_dequeuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            const auto seq  = cell(pos).sequence.load(std::memory_order_acquire);
+            const auto diff = seq - (pos + 1);
+            if (diff == 0)
+            {
+                if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                // buffer is empty
+                return false;
+            }
+            else
+            {
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        idx = pos;
+        return true;
+    }
+    int64_t try_claim_read_n(int64_t maxCount, int64_t& first)
+    {
+        auto pos  = m_dequeuePos.load(std::memory_order_relaxed);
+        int64_t n = 0;
+        for (;;)
+        {
+            // count the published slots at the head of the ring
+            for (n = 0; n < maxCount; n++)
+            {
+                const auto seq = cell(pos + n).sequence.load(std::memory_order_acquire);
+                if (seq != pos + n + 1)
+                    break;
+            }
+            if (n > 0)
+            {
+                if (m_dequeuePos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed))
+                    break;
+            }
+            else
+            {
+                const auto current = m_dequeuePos.load(std::memory_order_relaxed);
+                if (current == pos)
+                {
+                    // buffer is empty
+                    return 0;
+                }
+                pos = current;
+            }
+        }
+        first = pos;
+        return n;
+    }
+    void publish_read(int64_t idx)
+    {
+        cell(idx).sequence.store(idx + TSize, std::memory_order_release);
+    }
+    void publish_read_n(int64_t first, int64_t n)
+    {
+        for (int64_t i = 0; i < n; i++)
+        {
+            publish_read(first + i);
+        }
+    }
+    T& slot(int64_t idx) noexcept
+    {
+        return cell(idx).value;
+    }
+    int64_t size() const noexcept
+    {
+        return m_enqueuePos.load(std::memory_order_relaxed) -
+               m_dequeuePos.load(std::memory_order_relaxed);
+    }
+};
+
+#endif // TASKS_RING_H
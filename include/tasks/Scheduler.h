@@ -1,76 +1,408 @@
 #ifndef TASKS_SCHEDULER_H
 #define TASKS_SCHEDULER_H
 
+#include "CompletionCounter.h"
+#include "Future.h"
+#include "PoolResource.h"
+#include "Queue.h"
 #include "ThreadUtilities.h"
+#include "WorkStealingDeque.h"
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <future>
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <vector>
 
 namespace tasks
 {
-    template <typename TTaskQueue>
+    template <typename TTaskQueue, int64_t TDequeSize = 1024>
     class Scheduler;
+
+    // What an idle worker does while there is no task to run.
+    enum class IdlePolicy
+    {
+        Spin,         // busy-wait forever, lowest wake-up latency, burns a core per worker
+        Yield,        // busy-wait with std::this_thread::yield()
+        SpinThenPark, // busy-wait for spinCount rounds, then sleep until a task is submitted
+    };
+
+    // Where workers are allowed to run.
+    enum class CpuAffinity
+    {
+        None,     // let the OS migrate workers freely
+        Spread,   // pin worker i to the i-th CPU available to the process, wrapping around
+        Explicit, // pin worker i to cpus[i % cpus.size()]
+    };
+
+    struct SchedulerConfig
+    {
+        int threadCount{-1}; // <= 0 means one per available core, see availableConcurrency()
+        bool realtimePriority{false};
+        IdlePolicy idlePolicy{IdlePolicy::SpinThenPark};
+        int spinCount{4096};
+        RealtimePolicy realtimePolicy{RealtimePolicy::Fifo};
+        int realtimePriorityLevel{defaultRealtimePriority};
+        CpuAffinity affinity{CpuAffinity::None};
+        std::vector<int> cpus; // used by CpuAffinity::Explicit
+        std::size_t scratchSize{0}; // scratch bytes taken up front from the queue's pool per worker
+        // how often parked workers wake up to poll remote queues, whose posts do not wake them
+        std::chrono::microseconds remotePollInterval{1000};
+    };
 }
 
-template <typename TTaskQueue>
+// Runs the tasks of an external queue on a pool of worker threads. Every worker also owns a
+// work-stealing deque: tasks spawned from inside a task go to the local deque and idle workers
+// steal from the deques of random victims, so nested parallelism does not funnel through the
+// shared queue.
+template <typename TTaskQueue, int64_t TDequeSize>
 class tasks::Scheduler
 {
-    using future_type = std::future<typename TTaskQueue::task_return_type>;
+    using task_type     = typename TTaskQueue::task_type;
+    using pool_resource = memory::PoolResource<typename TTaskQueue::memory_pool_type>;
+
+    struct alignas(64) Worker
+    {
+        Scheduler* scheduler{nullptr};
+        uint32_t seed{1};
+        threadsafe::WorkStealingDeque<task_type, TDequeSize> deque;
+        std::pmr::memory_resource* upstream;
+        void* scratchBuffer{nullptr};
+        std::size_t scratchSize{0};
+        std::optional<std::pmr::monotonic_buffer_resource> scratch;
+
+        Worker(std::pmr::memory_resource* upstreamResource, std::size_t bufferSize)
+        : upstream(upstreamResource)
+        {
+            if (bufferSize > 0)
+            {
+                scratchBuffer = upstream->allocate(bufferSize);
+                scratchSize   = bufferSize;
+                scratch.emplace(scratchBuffer, scratchSize, upstream);
+            }
+            else
+            {
+                scratch.emplace(m_scratchChunkSize, upstream);
+            }
+        }
+        Worker(const Worker&) = delete;
+        Worker& operator=(const Worker&) = delete;
+        ~Worker()
+        {
+            scratch.reset();
+            if (scratchBuffer)
+                upstream->deallocate(scratchBuffer, scratchSize);
+        }
+    };
+
+    static constexpr int64_t m_maxBatchSize{TTaskQueue::max_batch_size};
+    static constexpr std::size_t m_scratchChunkSize{1024};
+    static inline thread_local Worker* t_worker{nullptr};
     std::atomic<bool> m_done{false};
     TTaskQueue& m_queue;
+    pool_resource m_poolResource;
+    const std::vector<TTaskQueue*> m_remoteQueues;
+    const SchedulerConfig m_config;
+    std::vector<int> m_cpus;
+    std::atomic<int> m_configurationFailures{0};
+    int64_t m_threadCount{1};
+    std::vector<std::unique_ptr<Worker>> m_workers;
     std::vector<std::thread> m_threads;
 
-    void workerThread()
+    // A worker claims its share of the pending tasks in one go, so a deep queue is drained with
+    // few atomic operations on the read counters while a shallow one is still spread over workers.
+    int64_t batchSize() const noexcept
+    {
+        return std::clamp<int64_t>(m_queue.size() / m_threadCount, 1, m_maxBatchSize);
+    }
+    static uint32_t nextRandom(Worker& worker) noexcept
+    {
+        // xorshift32
+        auto x = worker.seed;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return worker.seed = x;
+    }
+    bool trySteal(Worker& thief, task_type& task)
+    {
+        const auto count = m_workers.size();
+        const auto start = nextRandom(thief) % count;
+        for (size_t i = 0; i < count; i++)
+        {
+            auto& victim = *m_workers[(start + i) % count];
+            if (&victim != &thief && victim.deque.try_steal(task))
+                return true;
+        }
+        return false;
+    }
+    bool spawnTask(task_type&& task)
+    {
+        // tasks only pin their epoch through the queue, so they must not bypass it
+        if (!TTaskQueue::pins_epochs && t_worker && t_worker->scheduler == this &&
+            t_worker->deque.try_push(std::move(task)))
+        {
+            // let a parked worker come and steal it
+            m_queue.not_empty().notify_one();
+            return true;
+        }
+        return m_queue.try_post_task(std::move(task));
+    }
+    bool runNext(Worker& worker, task_type& task)
+    {
+        // scratch allocations only live as long as the task that made them
+        const auto releaseScratch = [&worker]() { worker.scratch->release(); };
+        if (worker.deque.try_take(task) ||
+            m_queue.try_call_next_n(batchSize(), releaseScratch) > 0 || trySteal(worker, task) ||
+            tryRemote())
+        {
+            if (task.valid())
+            {
+                task();
+                task.reset();
+            }
+            return true;
+        }
+        return false;
+    }
+    bool tryRemote()
+    {
+        for (auto* queue : m_remoteQueues)
+        {
+            if (queue->try_call_next())
+                return true;
+        }
+        return false;
+    }
+    bool hasWork() const noexcept
+    {
+        if (m_queue.size() > 0)
+            return true;
+        for (auto* queue : m_remoteQueues)
+        {
+            if (queue->size() > 0)
+                return true;
+        }
+        for (auto& worker : m_workers)
+        {
+            if (worker->deque.size() > 0)
+                return true;
+        }
+        return false;
+    }
+    void idle(int& idleRounds)
+    {
+        switch (m_config.idlePolicy)
+        {
+            case IdlePolicy::Spin:
+                cpuRelax();
+                return;
+            case IdlePolicy::Yield:
+                std::this_thread::yield();
+                return;
+            case IdlePolicy::SpinThenPark:
+                if (idleRounds++ < m_config.spinCount)
+                {
+                    cpuRelax();
+                    return;
+                }
+                break;
+        }
+        auto& notEmpty = m_queue.not_empty();
+        const auto key = notEmpty.prepare_wait();
+        if (m_done || hasWork())
+        {
+            notEmpty.cancel_wait();
+            return;
+        }
+        if (m_remoteQueues.empty())
+            notEmpty.wait(key);
+        else
+            notEmpty.wait_for(key, m_config.remotePollInterval);
+        idleRounds = 0;
+    }
+    // Workers configure themselves, so they are already pinned when they first touch memory.
+    void configureWorker(int index)
+    {
+        if (!m_cpus.empty() && !setThreadAffinity(nullptr, {m_cpus[index % m_cpus.size()]}))
+            ++m_configurationFailures;
+        if (m_config.realtimePriority &&
+            !setRealtimePriority(nullptr, m_config.realtimePolicy, m_config.realtimePriorityLevel))
+            ++m_configurationFailures;
+    }
+    void workerThread(Worker* worker, int index)
     {
+        t_worker = worker;
+        configureWorker(index);
         flushDenormalsToZero();
+        task_type task;
+        int idleRounds = 0;
         while (!m_done)
         {
-            while (m_queue.try_call_next())
+            if (runNext(*worker, task))
             {
+                worker->scratch->release();
+                idleRounds = 0;
+                continue;
             }
-            std::this_thread::yield();
+            idle(idleRounds);
+        }
+        t_worker = nullptr;
+    }
+    static SchedulerConfig makeConfig(int threadCount, bool realtimePriority)
+    {
+        SchedulerConfig config;
+        config.threadCount      = threadCount;
+        config.realtimePriority = realtimePriority;
+        return config;
+    }
+    void stop()
+    {
+        m_done = true;
+        m_queue.not_empty().notify_all();
+        for (auto& thread : m_threads)
+        {
+            if (thread.joinable())
+                thread.join();
         }
     }
 
 public:
     Scheduler(TTaskQueue& queue, int threadCount = -1, bool realtimePriority = false)
+    : Scheduler(queue, makeConfig(threadCount, realtimePriority))
+    {
+    }
+    // remoteQueues are only served once this scheduler's own queue and deques are empty.
+    // Submissions to them do not wake parked workers, which poll them every
+    // config.remotePollInterval instead.
+    Scheduler(TTaskQueue& queue,
+              const SchedulerConfig& config,
+              std::vector<TTaskQueue*> remoteQueues = {})
     : m_queue(queue)
+    , m_poolResource(queue.memory_pool())
+    , m_remoteQueues(std::move(remoteQueues))
+    , m_config(config)
     {
+        int threadCount = config.threadCount;
         if (threadCount <= 0)
         {
-            threadCount = std::thread::hardware_concurrency();
+            threadCount = availableConcurrency();
         }
         else
         {
-            threadCount = std::min<int>(threadCount, std::thread::hardware_concurrency());
+            threadCount = std::min<int>(threadCount, availableConcurrency());
+        }
+        m_threadCount = threadCount;
+
+        if (config.affinity == CpuAffinity::Spread)
+            m_cpus = availableCpus();
+        else if (config.affinity == CpuAffinity::Explicit)
+            m_cpus = config.cpus;
+
+        for (int i = 0; i < threadCount; i++)
+        {
+            m_workers.emplace_back(std::make_unique<Worker>(&m_poolResource, config.scratchSize));
+            m_workers[i]->scheduler = this;
+            m_workers[i]->seed      = 2463534242u + uint32_t(i) * 2654435761u;
         }
 
         try
         {
             for (int i = 0; i < threadCount; i++)
             {
-                m_threads.emplace_back(std::thread(&Scheduler::workerThread, this));
-                if (realtimePriority)
-                {
-                    setRealtimePriority(&m_threads[i]);
-                }
+                m_threads.emplace_back(
+                    std::thread(&Scheduler::workerThread, this, m_workers[i].get(), i));
             }
         }
         catch (...)
         {
-            m_done = true;
+            stop();
             throw;
         }
     }
     ~Scheduler()
     {
-        m_done = true;
-        for (auto& thread : m_threads)
-        {
-            if (thread.joinable())
-                thread.join();
-        }
+        stop();
+    }
+
+    // Number of workers so far that could not apply the requested realtime priority or affinity.
+    int configurationFailures() const noexcept
+    {
+        return m_configurationFailures.load();
+    }
+
+    // The queue's memory pool as a memory resource, e.g. for std::pmr containers built in tasks.
+    std::pmr::memory_resource* memory_resource() noexcept
+    {
+        return &m_poolResource;
+    }
+    // Scratch memory of the calling worker, drawn from the queue's pool, for allocations that do
+    // not outlive the running task: it is recycled as soon as the task has run. Called outside the
+    // workers of this scheduler, returns the default resource.
+    std::pmr::memory_resource* scratch_resource() noexcept
+    {
+        if (t_worker && t_worker->scheduler == this)
+            return &*t_worker->scratch;
+        return std::pmr::get_default_resource();
+    }
+
+    // Runs func(args...) on one of the workers. Called from inside a task of this scheduler, the
+    // task goes to the calling worker's deque, otherwise (or when that deque is full) to the queue.
+    template <typename TCallable, typename... Args>
+    bool spawn(TCallable&& func, Args&&... args)
+    {
+        return spawnTask(
+            m_queue.make_task(std::forward<TCallable>(func), std::forward<Args>(args)...));
+    }
+    // Same as spawn(), running the task on the calling thread when it cannot be queued, so that a
+    // full queue never drops it, e.g. for tasks that complete a promise.
+    template <typename TCallable, typename... Args>
+    void spawn_or_run(TCallable&& func, Args&&... args)
+    {
+        auto task = m_queue.make_task(std::forward<TCallable>(func), std::forward<Args>(args)...);
+        if (!spawnTask(std::move(task)))
+            task();
+    }
+    // Same as spawn(), returning a future of whatever func(args...) returns: tasks of every return
+    // type share the queue and the workers. The future is invalid if the task was not queued.
+    template <typename TCallable, typename... Args>
+    auto submit(TCallable&& func, Args&&... args)
+    {
+        auto [task, future] =
+            m_queue.make_future_task(std::forward<TCallable>(func), std::forward<Args>(args)...);
+        if (!spawnTask(std::move(task)))
+            return decltype(future){};
+        return std::move(future);
+    }
+    // Same as submit(), with a tasks::Future whose shared state comes from the queue's pool:
+    // waiting on it spins before parking, and then() chains continuations onto this scheduler. A
+    // task the queue cannot take runs on the calling thread, so the future is always valid.
+    template <typename TCallable, typename... Args>
+    auto async(TCallable&& func, Args&&... args)
+    {
+        using result_type = detail::call_result_t<TCallable, Args...>;
+        Promise<result_type> promise(std::allocator_arg,
+                                     std::pmr::polymorphic_allocator<char>(&m_poolResource));
+        auto future = promise.get_future();
+        spawn_or_run([promise  = std::move(promise),
+                      callable = detail::bindCall(std::forward<TCallable>(func),
+                                                  std::forward<Args>(args)...)]() mutable {
+            detail::fulfil(promise, callable);
+        });
+        return future;
+    }
+    template <typename TCallable, typename... Args>
+    bool spawn(CompletionCounter& counter, TCallable&& func, Args&&... args)
+    {
+        counter.increment();
+        const bool spawned = spawnTask(
+            m_queue.make_task(counter, std::forward<TCallable>(func), std::forward<Args>(args)...));
+        if (!spawned)
+            counter.decrement();
+        return spawned;
     }
 };
 
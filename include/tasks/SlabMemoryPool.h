@@ -0,0 +1,135 @@
+#ifndef TASKS_SLAB_MEMORY_POOL_H
+#define TASKS_SLAB_MEMORY_POOL_H
+
+#include "Allocator.h"
+#include "FreeList.h"
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+namespace tasks
+{
+    namespace memory
+    {
+        template <std::size_t N, std::size_t alignment = alignof(std::max_align_t)>
+        class SlabMemoryPool;
+    }
+}
+
+// Pool with power-of-two size classes. Blocks are carved from the buffer on first use and, once
+// released, recycled through a lock-free free list per size class, in any order and from any
+// thread. A long running process therefore stays within the buffer as long as its peak usage
+// fits, whereas MemoryPool only reclaims the most recent allocation.
+template <std::size_t N, std::size_t alignment>
+class tasks::memory::SlabMemoryPool
+{
+public:
+    static constexpr std::size_t min_block_size =
+        alignment > sizeof(uint32_t) ? alignment : sizeof(uint32_t);
+    static constexpr std::size_t max_block_size = N / 8 < 65536 ? N / 8 : 65536;
+
+private:
+    static constexpr int classCount() noexcept
+    {
+        int count = 1;
+        for (auto size = min_block_size; size < max_block_size; size *= 2)
+            count++;
+        return count;
+    }
+    static constexpr int m_classCount{classCount()};
+
+    alignas(alignment) char m_buf[N];
+    std::atomic<std::size_t> m_carved{0};
+    detail::FreeList m_freeLists[m_classCount];
+
+    static constexpr std::size_t blockSize(int sizeClass) noexcept
+    {
+        return min_block_size << sizeClass;
+    }
+    static int sizeClass(std::size_t n) noexcept
+    {
+        int c = 0;
+        while (blockSize(c) < n)
+            c++;
+        return c;
+    }
+    char* carve(std::size_t size) noexcept
+    {
+        auto offset = m_carved.load(std::memory_order_relaxed);
+        do
+        {
+            if (N - offset < size)
+                return nullptr;
+        } while (!m_carved.compare_exchange_weak(
+            offset, offset + size, std::memory_order_relaxed, std::memory_order_relaxed));
+        return m_buf + offset;
+    }
+
+public:
+    SlabMemoryPool() noexcept
+    {
+        static_assert(N / alignment < (std::size_t(1) << 32) - 1, "memory pool is too large");
+        static_assert((alignment & (alignment - 1)) == 0, "alignment must be a power of two");
+        static_assert(alignment <= max_pool_alignment, "alignment is larger than a page");
+    }
+    SlabMemoryPool(const SlabMemoryPool&) = delete;
+    SlabMemoryPool& operator=(const SlabMemoryPool&) = delete;
+    ~SlabMemoryPool()                                = default;
+
+    template <std::size_t ReqAlign>
+    char* allocate(std::size_t n)
+    {
+        static_assert(ReqAlign <= alignment, "alignment is too small for this memory pool");
+        char* r = nullptr;
+        if (n <= max_block_size)
+        {
+            const int c = sizeClass(n);
+            r           = m_freeLists[c].pop(m_buf, alignment);
+            if (!r)
+                r = carve(blockSize(c));
+        }
+        if (!r)
+        {
+            assert(false && "Memory pool exhausted");
+            return detail::allocateFromHeap<alignment>(n);
+        }
+        return r;
+    }
+    void deallocate(char* p, std::size_t n) noexcept
+    {
+        if (owns(p))
+            m_freeLists[sizeClass(n)].push(m_buf, alignment, p);
+        else
+            detail::deallocateToHeap<alignment>(p);
+    }
+
+    static constexpr std::size_t size() noexcept
+    {
+        return N;
+    }
+    bool owns(const char* p) const noexcept
+    {
+        return m_buf <= p && p < m_buf + N;
+    }
+    // bytes carved into blocks so far, free or not
+    std::size_t used() const noexcept
+    {
+        return m_carved.load(std::memory_order_relaxed);
+    }
+    // Only safe once no block of the pool is in use anymore.
+    void reset() noexcept
+    {
+        for (auto& list : m_freeLists)
+            list.clear();
+        m_carved.store(0, std::memory_order_release);
+    }
+    void prefault() noexcept
+    {
+        std::memset(m_buf, 0, N);
+    }
+};
+
+#endif // TASKS_SLAB_MEMORY_POOL_H
@@ -0,0 +1,196 @@
+#ifndef TASKS_TASK_H
+#define TASKS_TASK_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace tasks
+{
+    template <std::size_t TInlineSize = 48>
+    class Task;
+}
+
+// Move-only, type-erased void() callable. Callables of up to TInlineSize bytes are stored inline,
+// so a task living in a queue slot needs no allocation at all. Larger callables are placed in
+// memory obtained from the allocator given at construction.
+// It replaces std::packaged_task's allocator-aware constructor, which was removed in C++17.
+template <std::size_t TInlineSize>
+class tasks::Task final
+{
+    struct VTable
+    {
+        void (*invoke)(void* storage);
+        void (*move)(void* dst, void* src) noexcept;
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template <typename TFunc>
+    struct InlineVTable
+    {
+        static TFunc& get(void* storage) noexcept
+        {
+            return *std::launder(reinterpret_cast<TFunc*>(storage)); // NOLINT
+        }
+        static void invoke(void* storage)
+        {
+            get(storage)();
+        }
+        static void move(void* dst, void* src) noexcept
+        {
+            ::new (dst) TFunc(std::move(get(src)));
+            get(src).~TFunc();
+        }
+        static void destroy(void* storage) noexcept
+        {
+            get(storage).~TFunc();
+        }
+        static constexpr VTable value{&invoke, &move, &destroy};
+    };
+
+    template <typename TFunc, typename TAllocator>
+    struct AllocatedVTable
+    {
+        struct Holder
+        {
+            using allocator_type =
+                typename std::allocator_traits<TAllocator>::template rebind_alloc<Holder>;
+            using allocator_traits = std::allocator_traits<allocator_type>;
+
+            TFunc m_func;
+            allocator_type m_allocator;
+
+            template <typename TArg>
+            Holder(TArg&& func, const allocator_type& allocator)
+            : m_func(std::forward<TArg>(func))
+            , m_allocator(allocator)
+            {
+            }
+        };
+        using allocator_type   = typename Holder::allocator_type;
+        using allocator_traits = typename Holder::allocator_traits;
+
+        static Holder*& get(void* storage) noexcept
+        {
+            return *std::launder(reinterpret_cast<Holder**>(storage)); // NOLINT
+        }
+        static void invoke(void* storage)
+        {
+            get(storage)->m_func();
+        }
+        static void move(void* dst, void* src) noexcept
+        {
+            ::new (dst) Holder*(get(src));
+        }
+        static void destroy(void* storage) noexcept
+        {
+            auto* holder = get(storage);
+            allocator_type allocator(holder->m_allocator);
+            holder->~Holder();
+            allocator_traits::deallocate(allocator, holder, 1);
+        }
+        static constexpr VTable value{&invoke, &move, &destroy};
+    };
+
+    const VTable* m_vtable{nullptr};
+    alignas(std::max_align_t) unsigned char m_storage[TInlineSize];
+
+    void release() noexcept
+    {
+        if (m_vtable)
+        {
+            m_vtable->destroy(m_storage);
+            m_vtable = nullptr;
+        }
+    }
+
+public:
+    static_assert(TInlineSize >= sizeof(void*), "Task inline storage must fit a pointer");
+
+    template <typename TFunc>
+    static constexpr bool stores_inline = sizeof(TFunc) <= TInlineSize &&
+                                          alignof(TFunc) <= alignof(std::max_align_t) &&
+                                          std::is_nothrow_move_constructible<TFunc>::value;
+
+    Task() noexcept = default;
+    template <typename TAllocator, typename TFunc>
+    Task(std::allocator_arg_t, const TAllocator& allocator, TFunc&& func)
+    {
+        using func_type = std::decay_t<TFunc>;
+        if constexpr (stores_inline<func_type>)
+        {
+            (void)allocator;
+            ::new (static_cast<void*>(m_storage)) func_type(std::forward<TFunc>(func));
+            m_vtable = &InlineVTable<func_type>::value;
+        }
+        else
+        {
+            using vtable_type      = AllocatedVTable<func_type, TAllocator>;
+            using allocator_type   = typename vtable_type::allocator_type;
+            using allocator_traits = typename vtable_type::allocator_traits;
+
+            allocator_type alloc(allocator);
+            auto* p = allocator_traits::allocate(alloc, 1);
+            try
+            {
+                // placement new, scoped allocators such as std::pmr's would pass themselves on
+                ::new (static_cast<void*>(p))
+                    typename vtable_type::Holder(std::forward<TFunc>(func), alloc);
+            }
+            catch (...)
+            {
+                allocator_traits::deallocate(alloc, p, 1);
+                throw;
+            }
+            ::new (static_cast<void*>(m_storage)) decltype(p)(p);
+            m_vtable = &vtable_type::value;
+        }
+    }
+    Task(const Task&) = delete;
+    Task(Task&& other) noexcept
+    : m_vtable(other.m_vtable)
+    {
+        if (m_vtable)
+        {
+            m_vtable->move(m_storage, other.m_storage);
+            other.m_vtable = nullptr;
+        }
+    }
+    Task& operator=(const Task&) = delete;
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            if (other.m_vtable)
+            {
+                other.m_vtable->move(m_storage, other.m_storage);
+                m_vtable       = other.m_vtable;
+                other.m_vtable = nullptr;
+            }
+        }
+        return *this;
+    }
+    ~Task()
+    {
+        release();
+    }
+
+    bool valid() const noexcept
+    {
+        return m_vtable != nullptr;
+    }
+    // Destroys the callable and whatever it captured, leaving the task empty.
+    void reset() noexcept
+    {
+        release();
+    }
+    void operator()()
+    {
+        m_vtable->invoke(m_storage);
+    }
+};
+
+#endif // TASKS_TASK_H
@@ -0,0 +1,192 @@
+#ifndef TASKS_TASK_GRAPH_H
+#define TASKS_TASK_GRAPH_H
+
+#include "CompletionCounter.h"
+#include "Future.h"
+#include "Task.h"
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace tasks
+{
+    class TaskGraph;
+}
+
+// Directed acyclic graph of tasks run on a Scheduler. Every node counts its pending predecessors
+// with an atomic counter; the node that brings a successor's count to zero enqueues it, so no task
+// ever blocks on another one. Nodes and edges are stored once and the graph can be run again and
+// again: a run only resets the counters and spawns tasks small enough to be stored inline, so
+// repeated runs do not allocate.
+// wait() parks the calling thread until the last node of the run has finished.
+// Node functions must not throw, edges must not form a cycle, and the graph must not be modified
+// while it runs.
+class tasks::TaskGraph final
+{
+public:
+    using node_id = std::size_t;
+
+private:
+    static constexpr uint32_t m_parkedFlag{1};
+
+    struct Node
+    {
+        Task<> work;
+        std::vector<node_id> successors;
+        int predecessors{0};
+        std::atomic<int> pending{0};
+
+        template <typename TCallable>
+        explicit Node(TCallable&& func)
+        : work(std::allocator_arg, std::allocator<char>(), std::forward<TCallable>(func))
+        {
+        }
+        // nodes only move while the graph is being built
+        Node(Node&& other) noexcept
+        : work(std::move(other.work))
+        , successors(std::move(other.successors))
+        , predecessors(other.predecessors)
+        {
+        }
+    };
+
+    std::vector<Node> m_nodes;
+    CompletionCounter m_remaining;
+    // Finished runs << 1 | parked flag. Only finishRun() marks a run as done, and its update is
+    // the last access a worker makes to the graph: unparkAll() only uses the word's address, so
+    // the graph may already be gone by then.
+    mutable std::atomic<uint32_t> m_finished{0};
+    uint32_t m_runs{0};
+
+    uint32_t runsStarted() const noexcept
+    {
+        return m_runs & (~uint32_t(0) >> 1);
+    }
+    void finishRun() noexcept
+    {
+        auto word = m_finished.load(std::memory_order_relaxed);
+        while (!m_finished.compare_exchange_weak(
+            word, (word + 2) & ~m_parkedFlag, std::memory_order_acq_rel, std::memory_order_relaxed))
+        {
+        }
+        if (word & m_parkedFlag)
+            detail::unparkAll(m_finished);
+    }
+
+    template <typename TScheduler>
+    void spawnNode(TScheduler& scheduler, node_id id)
+    {
+        if (!scheduler.spawn([this, &scheduler, id]() { runNode(scheduler, id); }))
+            runNode(scheduler, id);
+    }
+    // Runs the node, spawns all of its successors that became ready but one, and carries on with
+    // that one on the same worker.
+    template <typename TScheduler>
+    void runNode(TScheduler& scheduler, node_id id)
+    {
+        for (;;)
+        {
+            auto& node = m_nodes[id];
+            node.work();
+
+            bool next = false;
+            node_id nextId{0};
+            for (const auto successor : node.successors)
+            {
+                if (m_nodes[successor].pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                    continue;
+                if (next)
+                    spawnNode(scheduler, nextId);
+                nextId = successor;
+                next   = true;
+            }
+            if (m_remaining.decrement())
+                finishRun();
+            if (!next)
+                return;
+            id = nextId;
+        }
+    }
+
+public:
+    TaskGraph()                 = default;
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+    ~TaskGraph()
+    {
+        assert(done() && "task graph destroyed while running");
+    }
+
+    void reserve(std::size_t nodes)
+    {
+        m_nodes.reserve(nodes);
+    }
+    // Adds a node running func() on every run of the graph.
+    template <typename TCallable>
+    node_id add_node(TCallable&& func)
+    {
+        m_nodes.emplace_back(std::forward<TCallable>(func));
+        return m_nodes.size() - 1;
+    }
+    // to only runs once from has run
+    void add_edge(node_id from, node_id to)
+    {
+        assert(from < m_nodes.size() && to < m_nodes.size() && from != to);
+        m_nodes[from].successors.push_back(to);
+        m_nodes[to].predecessors++;
+    }
+    std::size_t size() const noexcept
+    {
+        return m_nodes.size();
+    }
+
+    // Starts a run on scheduler's workers and returns right away, see wait().
+    template <typename TScheduler>
+    void run(TScheduler& scheduler)
+    {
+        assert(done() && "task graph is already running");
+        if (m_nodes.empty())
+            return;
+        m_runs++;
+        for (auto& node : m_nodes)
+            node.pending.store(node.predecessors, std::memory_order_relaxed);
+        m_remaining.increment(static_cast<int64_t>(m_nodes.size()));
+        for (node_id id = 0; id < m_nodes.size(); id++)
+        {
+            if (m_nodes[id].predecessors == 0)
+                spawnNode(scheduler, id);
+        }
+    }
+    bool done() const noexcept
+    {
+        return (m_finished.load(std::memory_order_acquire) >> 1) == runsStarted();
+    }
+    void wait() const noexcept
+    {
+        const auto runs = runsStarted();
+        auto word       = m_finished.load(std::memory_order_acquire);
+        while ((word >> 1) != runs)
+        {
+            if (!(word & m_parkedFlag) &&
+                !m_finished.compare_exchange_weak(word,
+                                                  word | m_parkedFlag,
+                                                  std::memory_order_acq_rel,
+                                                  std::memory_order_acquire))
+                continue;
+            detail::parkWhile(m_finished, word | m_parkedFlag);
+            word = m_finished.load(std::memory_order_acquire);
+        }
+    }
+    template <typename TScheduler>
+    void run_and_wait(TScheduler& scheduler)
+    {
+        run(scheduler);
+        wait();
+    }
+};
+
+#endif // TASKS_TASK_GRAPH_H
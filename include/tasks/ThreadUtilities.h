@@ -1,14 +1,44 @@
 #ifndef TASKS_REALTIME_H
 #define TASKS_REALTIME_H
 
+#include <emmintrin.h>
+#include <string>
 #include <thread>
 #include <vector>
 
 namespace tasks
 {
-    void setRealtimePriority(std::thread* thread);
+    enum class RealtimePolicy
+    {
+        Fifo,       // SCHED_FIFO
+        RoundRobin, // SCHED_RR
+    };
+    constexpr int defaultRealtimePriority = 80;
+
+    // A null thread means the calling thread. Both return false when the request could not be
+    // applied, e.g. for lack of privileges (CAP_SYS_NICE on Linux) or on an unsupported platform.
+    // On Apple the thread gets a time constraint policy and policy/priority are ignored.
+    bool setRealtimePriority(std::thread* thread,
+                             RealtimePolicy policy = RealtimePolicy::Fifo,
+                             int priority          = defaultRealtimePriority);
+    bool setThreadAffinity(std::thread* thread, const std::vector<int>& cpus);
+    // CPUs the calling thread is allowed to run on.
+    std::vector<int> availableCpus();
+    // Whole CPUs granted by the cgroup (v2 cpu.max, v1 cpu.cfs_quota_us / cpu.cfs_period_us) of
+    // the process, or 0 if there is no quota. Quotas of less than one CPU count as one.
+    int cgroupCpuLimit(const std::string& cgroupRoot      = "/sys/fs/cgroup",
+                       const std::string& procCgroupFile = "/proc/self/cgroup");
+    // Number of workers that can run in parallel: the CPUs in the affinity mask, capped by the
+    // cgroup quota. Unlike std::thread::hardware_concurrency() it honours container limits.
+    int availableConcurrency();
     void flushDenormalsToZero();
     class ThreadJoiner;
+
+    // spin-wait hint, keeps a busy-waiting core from starving its hyper-thread sibling
+    inline void cpuRelax() noexcept
+    {
+        _mm_pause();
+    }
 }
 
 #endif // TASKS_REALTIME_H
@@ -0,0 +1,126 @@
+#ifndef TASKS_WORK_STEALING_DEQUE_H
+#define TASKS_WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace tasks
+{
+    namespace threadsafe
+    {
+        template <typename T, int64_t TSize>
+        class WorkStealingDeque;
+    }
+}
+
+// Bounded Chase-Lev deque (with the C11 orderings of Le et al.). The owner thread pushes and takes
+// at the bottom, any other thread steals from the top.
+// Slots hold non-trivial objects, so an element is only moved out after its index has been won,
+// and every slot carries a flag the owner checks before reusing it: a thief that won index i may
+// still be moving out of the slot when the owner wraps around to index i + TSize.
+template <typename T, int64_t TSize>
+class tasks::threadsafe::WorkStealingDeque final
+{
+    struct Cell
+    {
+        std::atomic<bool> occupied{false};
+        T value{};
+    };
+
+    alignas(64) std::atomic<int64_t> m_top{0};
+    alignas(64) std::atomic<int64_t> m_bottom{0};
+    alignas(64) std::vector<Cell> m_cells;
+    static constexpr int64_t m_bitmask{TSize - 1};
+
+    Cell& cell(int64_t idx) noexcept
+    {
+        return m_cells[idx & m_bitmask];
+    }
+    static void moveOut(Cell& c, T& value)
+    {
+        value = std::move(c.value);
+        c.value = T{};
+        c.occupied.store(false, std::memory_order_release);
+    }
+
+public:
+    static constexpr int64_t capacity = TSize;
+
+    WorkStealingDeque() noexcept(false)
+    : m_cells(TSize)
+    {
+        static_assert(TSize > 0 && (TSize & (TSize - 1)) == 0,
+                      "Deque size must be a power of two");
+    }
+
+    // owner only
+    bool try_push(T&& value)
+    {
+        const auto b = m_bottom.load(std::memory_order_relaxed);
+        const auto t = m_top.load(std::memory_order_acquire);
+        if (b - t >= TSize)
+            return false;
+
+        auto& c = cell(b);
+        while (c.occupied.load(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+        c.value = std::move(value);
+        c.occupied.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+    // owner only
+    bool try_take(T& value)
+    {
+        const auto b = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto t = m_top.load(std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            // empty
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        if (t == b)
+        {
+            // last element, race against thieves
+            const bool won = m_top.compare_exchange_strong(
+                t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            if (!won)
+                return false;
+        }
+        moveOut(cell(b), value);
+        return true;
+    }
+    // any thread
+    bool try_steal(T& value)
+    {
+        auto t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const auto b = m_bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return false;
+
+        if (!m_top.compare_exchange_strong(
+                t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return false;
+        moveOut(cell(t), value);
+        return true;
+    }
+    int64_t size() const noexcept
+    {
+        const auto b = m_bottom.load(std::memory_order_relaxed);
+        const auto t = m_top.load(std::memory_order_relaxed);
+        return b > t ? b - t : 0;
+    }
+};
+
+#endif // TASKS_WORK_STEALING_DEQUE_H
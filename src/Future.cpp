@@ -0,0 +1,63 @@
+#include "tasks/Future.h"
+
+// clang-format off
+#include <cstdint>
+#if __linux__
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#else
+    #include <condition_variable>
+    #include <mutex>
+#endif
+// clang-format on
+
+#if __linux__
+
+void tasks::detail::parkWhile(const std::atomic<uint32_t>& word, uint32_t value) noexcept
+{
+    syscall(SYS_futex, &word, FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+}
+
+void tasks::detail::unparkAll(const std::atomic<uint32_t>& word) noexcept
+{
+    syscall(SYS_futex, &word, FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+#else
+
+namespace
+{
+    // waiters of different words share a spot, picked by address
+    struct alignas(64) Spot
+    {
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+
+    Spot& spotOf(const void* address) noexcept
+    {
+        static Spot spots[64];
+        const auto key = reinterpret_cast<std::uintptr_t>(address) >> 4; // NOLINT
+        return spots[(key ^ (key >> 6)) % 64];
+    }
+}
+
+void tasks::detail::parkWhile(const std::atomic<uint32_t>& word, uint32_t value) noexcept
+{
+    auto& spot = spotOf(&word);
+    std::unique_lock<std::mutex> lock(spot.mutex);
+    while (word.load(std::memory_order_acquire) == value)
+        spot.condition.wait(lock);
+}
+
+void tasks::detail::unparkAll(const std::atomic<uint32_t>& word) noexcept
+{
+    auto& spot = spotOf(&word);
+    {
+        std::lock_guard<std::mutex> lock(spot.mutex);
+    }
+    spot.condition.notify_all();
+}
+
+#endif
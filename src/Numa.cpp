@@ -0,0 +1,83 @@
+#include "tasks/Numa.h"
+#include "tasks/ThreadUtilities.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#if __linux__
+    #include <sched.h>
+#endif
+
+std::vector<int> tasks::numa::parseCpuList(const std::string& list)
+{
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ','))
+    {
+        if (range.empty() || range == "\n")
+            continue;
+        const auto dash  = range.find('-');
+        const int first  = std::atoi(range.substr(0, dash).c_str());
+        const int last   = dash == std::string::npos ? first
+                                                     : std::atoi(range.substr(dash + 1).c_str());
+        for (int cpu = first; cpu <= last; cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+std::vector<tasks::numa::Node> tasks::numa::discoverTopology(const std::string& sysfsRoot)
+{
+    namespace fs = std::filesystem;
+
+    auto allowed = availableCpus();
+    std::sort(allowed.begin(), allowed.end());
+
+    std::vector<Node> nodes;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(sysfsRoot, error))
+    {
+        const auto name = entry.path().filename().string();
+        if (name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+            name.find_first_not_of("0123456789", 4) != std::string::npos)
+            continue;
+
+        std::ifstream file(entry.path() / "cpulist");
+        std::string list;
+        std::getline(file, list);
+
+        Node node;
+        node.id = std::atoi(name.c_str() + 4);
+        for (const auto cpu : parseCpuList(list))
+        {
+            if (std::binary_search(allowed.begin(), allowed.end(), cpu))
+                node.cpus.push_back(cpu);
+        }
+        if (!node.cpus.empty())
+            nodes.push_back(std::move(node));
+    }
+    std::sort(nodes.begin(), nodes.end(), [](const Node& a, const Node& b) { return a.id < b.id; });
+
+    if (nodes.empty())
+    {
+        nodes.emplace_back();
+        nodes.back().cpus = allowed;
+    }
+    return nodes;
+}
+int tasks::numa::currentNode(const std::vector<Node>& nodes)
+{
+#if __linux__
+    const int cpu = sched_getcpu();
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        if (std::find(nodes[i].cpus.begin(), nodes[i].cpus.end(), cpu) != nodes[i].cpus.end())
+            return int(i);
+    }
+#endif
+    (void)nodes;
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include "tasks/Pages.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+
+namespace
+{
+    std::size_t roundUp(std::size_t n, std::size_t multiple) noexcept
+    {
+        return (n + multiple - 1) / multiple * multiple;
+    }
+    // Touches one byte per page, for systems without MAP_POPULATE.
+    void touchPages(void* data, std::size_t bytes) noexcept
+    {
+        auto* p           = static_cast<volatile char*>(data);
+        const auto stride = tasks::memory::pageSize();
+        for (std::size_t offset = 0; offset < bytes; offset += stride)
+            p[offset] = 0;
+    }
+}
+
+std::size_t tasks::memory::pageSize() noexcept
+{
+    static const auto size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+std::size_t tasks::memory::hugePageSize() noexcept
+{
+    static const std::size_t size = []() -> std::size_t {
+        std::ifstream meminfo("/proc/meminfo");
+        std::string key;
+        std::size_t value = 0;
+        while (meminfo >> key >> value)
+        {
+            if (key == "Hugepagesize:")
+                return value * 1024;
+            meminfo.ignore(256, '\n');
+        }
+        return 0;
+    }();
+    return size;
+}
+
+void* tasks::memory::mapPages(std::size_t bytes) noexcept
+{
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? nullptr : p;
+}
+
+void tasks::memory::unmapPages(void* p, std::size_t bytes) noexcept
+{
+    if (p)
+        munmap(p, bytes);
+}
+
+tasks::memory::Mapping tasks::memory::mapPages(std::size_t bytes,
+                                               const PageOptions& options) noexcept
+{
+    Mapping mapping;
+    int populateFlag = 0;
+#ifdef MAP_POPULATE
+    populateFlag = options.populate ? MAP_POPULATE : 0;
+#endif
+
+#ifdef MAP_HUGETLB
+    const auto hugeSize = hugePageSize();
+    if (options.hugePages && hugeSize > 0)
+    {
+        const auto length = roundUp(bytes, hugeSize);
+        void* p           = mmap(nullptr,
+                       length,
+                       PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | populateFlag,
+                       -1,
+                       0);
+        if (p != MAP_FAILED)
+        {
+            mapping.data      = p;
+            mapping.bytes     = length;
+            mapping.hugePages = true;
+        }
+    }
+#endif
+    if (!mapping.data)
+    {
+        // populating before madvise would settle the mapping on small pages
+        const auto length = roundUp(bytes, pageSize());
+        void* p           = mmap(nullptr,
+                       length,
+                       PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | (options.hugePages ? 0 : populateFlag),
+                       -1,
+                       0);
+        if (p == MAP_FAILED)
+            return Mapping{};
+        mapping.data  = p;
+        mapping.bytes = length;
+#ifdef MADV_HUGEPAGE
+        // only pays off when the kernel can back whole huge pages
+        if (options.hugePages)
+            mapping.transparentHugePages = madvise(p, length, MADV_HUGEPAGE) == 0;
+#endif
+    }
+
+    if (options.populate)
+    {
+        // MAP_POPULATE is best effort, or was not used at all
+        touchPages(mapping.data, mapping.bytes);
+        mapping.populated = true;
+    }
+    if (options.lock)
+        mapping.locked = mlock(mapping.data, mapping.bytes) == 0;
+    return mapping;
+}
+
+void tasks::memory::unmapPages(const Mapping& mapping) noexcept
+{
+    if (mapping.data)
+    {
+        if (mapping.locked)
+            munlock(mapping.data, mapping.bytes);
+        munmap(mapping.data, mapping.bytes);
+    }
+}
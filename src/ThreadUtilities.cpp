@@ -6,6 +6,11 @@
 #include <pthread.h>
 #include <signal.h>
 #include <sys/signal.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
 
 // flush-to-zero denormals
 #ifndef _MM_DENORMALS_ZERO_MASK
@@ -23,6 +28,8 @@
     #include <mach/thread_policy.h>
     #include <mach/thread_act.h>
     #include <CoreAudio/HostTime.h>
+#elif __linux__
+    #include <sched.h>
 #endif
 // clang-format on
 
@@ -31,11 +38,13 @@ void tasks::flushDenormalsToZero()
     _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
     _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
 }
-void tasks::setRealtimePriority(std::thread* thread)
+bool tasks::setRealtimePriority(std::thread* thread, RealtimePolicy policy, int priority)
 {
+    pthread_t inThread = thread ? thread->native_handle() : pthread_self();
 #if __APPLE__
     // REAL-TIME / TIME-CONSTRAINT THREAD
-    pthread_t inThread                = thread ? thread->native_handle() : pthread_self();
+    (void)policy;
+    (void)priority;
     UInt64 cycleDurationInNanoseconds = 10000000;
     thread_time_constraint_policy_data_t theTCPolicy;
     UInt64 theComputeQuanta;
@@ -50,9 +59,160 @@ void tasks::setRealtimePriority(std::thread* thread)
     theTCPolicy.computation = theComputeQuanta;
     theTCPolicy.constraint  = thePeriod;
     theTCPolicy.preemptible = true;
-    thread_policy_set(pthread_mach_thread_np(inThread),
-                      THREAD_TIME_CONSTRAINT_POLICY,
-                      (thread_policy_t)&theTCPolicy,
-                      THREAD_TIME_CONSTRAINT_POLICY_COUNT);
+    return thread_policy_set(pthread_mach_thread_np(inThread),
+                             THREAD_TIME_CONSTRAINT_POLICY,
+                             (thread_policy_t)&theTCPolicy,
+                             THREAD_TIME_CONSTRAINT_POLICY_COUNT) == KERN_SUCCESS;
+#elif __linux__
+    const int schedPolicy = policy == RealtimePolicy::RoundRobin ? SCHED_RR : SCHED_FIFO;
+    sched_param param{};
+    param.sched_priority = std::clamp(
+        priority, sched_get_priority_min(schedPolicy), sched_get_priority_max(schedPolicy));
+    return pthread_setschedparam(inThread, schedPolicy, &param) == 0;
+#else
+    (void)inThread;
+    (void)policy;
+    (void)priority;
+    return false;
 #endif
 }
+bool tasks::setThreadAffinity(std::thread* thread, const std::vector<int>& cpus)
+{
+#if __linux__
+    pthread_t inThread = thread ? thread->native_handle() : pthread_self();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const auto cpu : cpus)
+    {
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    }
+    if (CPU_COUNT(&set) == 0)
+        return false;
+    return pthread_setaffinity_np(inThread, sizeof(set), &set) == 0;
+#else
+    // macOS only offers affinity tags, not pinning
+    (void)thread;
+    (void)cpus;
+    return false;
+#endif
+}
+std::vector<int> tasks::availableCpus()
+{
+    std::vector<int> cpus;
+#if __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+        }
+    }
+#endif
+    if (cpus.empty())
+    {
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++)
+            cpus.push_back(int(cpu));
+    }
+    return cpus;
+}
+
+namespace
+{
+    // Quota in whole CPUs for a cgroup directory, 0 if it has none.
+    int readCgroupQuota(const std::string& dir)
+    {
+        {
+            // cgroup v2: "<quota> <period>" or "max <period>"
+            std::ifstream file(dir + "/cpu.max");
+            std::string quota;
+            long long period = 0;
+            if (file >> quota >> period)
+            {
+                const auto value = std::strtoll(quota.c_str(), nullptr, 10);
+                if (value <= 0 || period <= 0)
+                    return 0;
+                return std::max(1, int(value / period));
+            }
+        }
+        // cgroup v1: a quota of -1 means unlimited
+        std::ifstream quotaFile(dir + "/cpu.cfs_quota_us");
+        std::ifstream periodFile(dir + "/cpu.cfs_period_us");
+        long long quota  = 0;
+        long long period = 0;
+        if ((quotaFile >> quota) && (periodFile >> period) && quota > 0 && period > 0)
+            return std::max(1, int(quota / period));
+        return 0;
+    }
+    // Smallest quota found from the cgroup at path up to the root of the hierarchy mounted at
+    // mount. Inside a container the process path is usually not visible under the mount, whose
+    // root then is the container's own cgroup.
+    int hierarchyQuota(const std::string& mount, std::string path)
+    {
+        int limit = 0;
+        for (;;)
+        {
+            const int quota = readCgroupQuota(mount + path);
+            if (quota > 0)
+                limit = limit > 0 ? std::min(limit, quota) : quota;
+            if (path.empty() || path == "/")
+                break;
+            const auto slash = path.find_last_of('/');
+            path             = slash == std::string::npos ? "" : path.substr(0, slash);
+        }
+        return limit;
+    }
+}
+int tasks::cgroupCpuLimit(const std::string& cgroupRoot, const std::string& procCgroupFile)
+{
+    // each line of /proc/self/cgroup reads "<id>:<controllers>:<path>"
+    std::ifstream file(procCgroupFile);
+    std::string line;
+    int limit = 0;
+    while (std::getline(file, line))
+    {
+        const auto first  = line.find(':');
+        const auto second = line.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos)
+            continue;
+        const auto id          = line.substr(0, first);
+        const auto controllers = line.substr(first + 1, second - first - 1);
+        const auto path        = line.substr(second + 1);
+
+        int quota = 0;
+        if (id == "0" && controllers.empty())
+        {
+            quota = hierarchyQuota(cgroupRoot, path);
+        }
+        else
+        {
+            std::stringstream names(controllers);
+            std::string name;
+            bool hasCpu = false;
+            while (std::getline(names, name, ','))
+                hasCpu = hasCpu || name == "cpu";
+            if (!hasCpu)
+                continue;
+            for (const auto& mount : {controllers, std::string("cpu,cpuacct"), std::string("cpu")})
+            {
+                quota = hierarchyQuota(cgroupRoot + "/" + mount, path);
+                if (quota > 0)
+                    break;
+            }
+        }
+        if (quota > 0)
+            limit = limit > 0 ? std::min(limit, quota) : quota;
+    }
+    return limit;
+}
+int tasks::availableConcurrency()
+{
+    auto count      = int(availableCpus().size());
+    const int quota = cgroupCpuLimit();
+    if (quota > 0)
+        count = std::min(count, quota);
+    return std::max(1, count);
+}
@@ -1,13 +1,26 @@
 #include "tasks/Allocator.h"
+#include "tasks/ChainedMemoryPool.h"
+#include "tasks/DynamicMemoryPool.h"
+#include "tasks/EpochMemoryPool.h"
+#include "tasks/ArenaMemoryPool.h"
+#include "tasks/NumaScheduler.h"
+#include "tasks/PoolResource.h"
+#include "tasks/SlabMemoryPool.h"
 #include "tasks/Queue.h"
+#include "tasks/RecyclingMemoryPool.h"
 #include "tasks/Scheduler.h"
+#include "tasks/TaskGraph.h"
 #include "catch.hpp"
+#include <array>
 #include <new>
 #include <cmath>
 #include <limits>
 #include <future>
 #include <memory>
 #include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <string>
 
 // Replace new and delete just for the purpose of demonstrating that
 //  they are not called.
@@ -22,12 +35,25 @@ void* operator new(std::size_t s) /*throw() (std::bad_alloc)*/
     return malloc(s);
 }
 
+void* operator new(std::size_t s, const std::nothrow_t&) noexcept
+{
+    memory += s;
+    ++alloc;
+    return malloc(s);
+}
+
 void  operator delete(void* p) throw()
 {
     --alloc;
     free(p);
 }
 
+void operator delete(void* p, std::size_t) throw()
+{
+    --alloc;
+    free(p);
+}
+
 template <typename T>
 T max_value()
 {
@@ -50,6 +76,7 @@ struct Foo
     }
 };
 
+#if defined(_LIBCPP_VERSION) // libstdc++ dropped packaged_task's allocator constructor in C++17
 TEST_CASE("no memory is allocated in packaged_task", "[tasks]")
 {
     tasks::memory::Allocator<void, 1024> allocator;
@@ -91,6 +118,32 @@ TEST_CASE("no memory is allocated in packaged_task", "[tasks]")
     REQUIRE(task_float.get_future().get() == 8.75f);
 
 }
+#endif
+TEST_CASE("no memory is allocated in task", "[tasks]")
+{
+    tasks::memory::Allocator<void, 1024> allocator;
+    alloc = 0;
+    memory = 0;
+
+    int value = 0;
+    auto task = tasks::Task<>(std::allocator_arg, allocator, [&value]() { value = 42; });
+    REQUIRE(task.valid());
+    REQUIRE(alloc == 0);
+    REQUIRE(memory == 0);
+    task();
+    REQUIRE(value == 42);
+
+    auto promise = std::promise<int>(std::allocator_arg, allocator);
+    auto future = promise.get_future();
+    auto empty_task = tasks::Task<>{};
+    REQUIRE(!empty_task.valid());
+    empty_task = tasks::Task<>(
+        std::allocator_arg, allocator, [p = std::move(promise)]() mutable { p.set_value(7); });
+    REQUIRE(alloc == 0);
+    REQUIRE(memory == 0);
+    empty_task();
+    REQUIRE(future.get() == 7);
+}
 TEST_CASE("no memory is allocated in queue", "[tasks]")
 {
     using TaskQueue = tasks::threadsafe::Queue<int, 16, 4096>;
@@ -129,3 +182,1645 @@ TEST_CASE("no memory is allocated in queue", "[tasks]")
     REQUIRE(memory == 0);
     REQUIRE(future.get() == 5);
 }
+template <typename T>
+struct CountingAllocator
+{
+    using value_type = T;
+    static int allocations;
+
+    CountingAllocator() = default;
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>&) noexcept
+    {
+    }
+    T* allocate(std::size_t n)
+    {
+        ++CountingAllocator<void>::allocations;
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        --CountingAllocator<void>::allocations;
+        std::allocator<T>().deallocate(p, n);
+    }
+};
+template <typename T>
+int CountingAllocator<T>::allocations = 0;
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>&, const CountingAllocator<U>&)
+{
+    return true;
+}
+
+TEST_CASE("small callables are stored inline in task", "[tasks]")
+{
+    CountingAllocator<void> allocator;
+    int a = 0;
+    int b = 0;
+    int c = 0;
+    auto small = [&a, &b, &c]() { a = b = c = 1; };
+    static_assert(tasks::Task<>::stores_inline<decltype(small)>, "three pointers fit inline");
+
+    auto task = tasks::Task<>(std::allocator_arg, allocator, small);
+    REQUIRE(CountingAllocator<void>::allocations == 0);
+    auto moved = std::move(task);
+    REQUIRE(!task.valid());
+    moved();
+    REQUIRE(a + b + c == 3);
+
+    char payload[128] = {};
+    auto large = [payload, &a]() { a = payload[0] + 2; };
+    static_assert(!tasks::Task<>::stores_inline<decltype(large)>, "large capture needs the pool");
+    {
+        auto large_task = tasks::Task<>(std::allocator_arg, allocator, large);
+        REQUIRE(CountingAllocator<void>::allocations == 1);
+        moved = std::move(large_task);
+        moved();
+        REQUIRE(a == 2);
+    }
+    REQUIRE(CountingAllocator<void>::allocations == 1);
+    moved = tasks::Task<>{};
+    REQUIRE(CountingAllocator<void>::allocations == 0);
+
+    auto big_buffer_task = tasks::Task<256>(std::allocator_arg, allocator, large);
+    REQUIRE(CountingAllocator<void>::allocations == 0);
+    REQUIRE(sizeof(tasks::Task<>) == 64);
+}
+TEST_CASE("posting tasks touches neither heap nor pool", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<void, 16, 1024>;
+    TaskQueue queue;
+    // the queue's own pool, untouched as long as every task is stored inline
+    const auto before = queue.memory_pool().used();
+    alloc = 0;
+    memory = 0;
+
+    Foo foo;
+    int value = 0;
+    tasks::CompletionCounter counter;
+    REQUIRE(queue.try_post([&value]() { value += 1; }));
+    REQUIRE(queue.try_post(counter, [&value](int x) { value += x; }, 2));
+    REQUIRE(queue.try_post(counter, &Foo::sum, foo, 2, 3));
+    REQUIRE(counter.pending() == 2);
+    REQUIRE(queue.memory_pool().used() == before);
+    while (queue.try_call_next())
+    {
+    }
+    REQUIRE(counter.done());
+    counter.wait();
+    REQUIRE(value == 3);
+    REQUIRE(alloc == 0);
+    REQUIRE(memory == 0);
+    REQUIRE(queue.memory_pool().used() == before);
+}
+template <template <typename, int64_t> class TRing>
+void testBulkPost()
+{
+    using TaskQueue = tasks::threadsafe::Queue<void, 16, 1024, TRing>;
+    TaskQueue queue;
+
+    std::vector<int> values(8, 0);
+    tasks::CompletionCounter counter;
+    REQUIRE(queue.try_post_n(counter, 8, [&values](int64_t i) { values[i] = int(i); }));
+    REQUIRE(queue.size() == 8);
+    REQUIRE(counter.pending() == 8);
+    while (queue.try_call_next())
+    {
+    }
+    REQUIRE(counter.done());
+    for (int i = 0; i < 8; i++)
+        REQUIRE(values[i] == i);
+
+    int sum = 0;
+    std::vector<std::function<void()>> callables;
+    for (int i = 1; i <= 4; i++)
+        callables.emplace_back([&sum, i]() { sum += i; });
+    REQUIRE(queue.try_post_bulk(callables.begin(), callables.end()));
+    REQUIRE(queue.try_post_bulk(counter, callables.begin(), callables.begin() + 2));
+    REQUIRE(queue.size() == 6);
+    while (queue.try_call_next())
+    {
+    }
+    REQUIRE(sum == 10 + 3);
+    REQUIRE(counter.done());
+    REQUIRE(queue.try_post_bulk(callables.end(), callables.end()));
+
+    // all or nothing: no room for the whole block
+    REQUIRE(!queue.try_post_n(counter, 64, [&sum](int64_t) { sum++; }));
+    REQUIRE(counter.done());
+    REQUIRE(queue.size() == 0);
+
+    // all or nothing: copying the third callable throws
+    struct Throwing
+    {
+        int* copies;
+        int* runs;
+        Throwing(int* c, int* r)
+        : copies(c)
+        , runs(r)
+        {
+        }
+        Throwing(const Throwing& other)
+        : copies(other.copies)
+        , runs(other.runs)
+        {
+            if (++*copies == 3)
+                throw std::runtime_error("copy failed");
+        }
+        void operator()()
+        {
+            ++*runs;
+        }
+    };
+    int copies = -100; // not while filling the vector
+    int runs   = 0;
+    std::vector<Throwing> throwing(4, Throwing(&copies, &runs));
+    copies = 0;
+    REQUIRE_THROWS_AS(queue.try_post_bulk(counter, throwing.begin(), throwing.end()),
+                      std::runtime_error);
+    REQUIRE(counter.done());
+    while (queue.try_call_next())
+    {
+    }
+    REQUIRE(runs == 0);
+    counter.wait();
+}
+template <template <typename, int64_t> class TRing>
+void testBatchedDrain()
+{
+    using TaskQueue = tasks::threadsafe::Queue<void, 16, 1024, TRing>;
+    TaskQueue queue;
+
+    std::vector<int> order;
+    REQUIRE(queue.try_post_n(10, [&order](int64_t i) { order.push_back(int(i)); }));
+    REQUIRE(queue.try_call_next_n(4) == 4);
+    REQUIRE(queue.size() == 6);
+    REQUIRE(queue.try_call_next_n(16) == 6);
+    REQUIRE(queue.try_call_next_n(16) == 0);
+    REQUIRE(order.size() == 10);
+    for (int i = 0; i < 10; i++)
+        REQUIRE(order[i] == i);
+}
+TEST_CASE("batched drain runs consecutive tasks in order", "[tasks]")
+{
+    testBatchedDrain<tasks::threadsafe::SharedCounterRing>();
+    testBatchedDrain<tasks::threadsafe::SequencedRing>();
+}
+template <template <typename, int64_t> class TRing>
+void testBlockingTaskDoesNotHoldBackConsumers()
+{
+    using TaskQueue = tasks::threadsafe::Queue<void, 16, 1024, TRing>;
+    TaskQueue queue;
+
+    // A waits for C, which is only reached once B has been run and published by another consumer
+    std::atomic<bool> cDone{false};
+    std::atomic<bool> aStarted{false};
+    queue.try_post([&]() {
+        aStarted = true;
+        while (!cDone)
+            std::this_thread::yield();
+    });
+    queue.try_post([]() {});
+    queue.try_post([&cDone]() { cDone = true; });
+
+    std::thread first([&queue]() { queue.try_call_next(); });
+    while (!aStarted)
+        std::this_thread::yield();
+    std::thread second([&queue]() {
+        while (queue.try_call_next())
+        {
+        }
+    });
+    second.join();
+    first.join();
+    REQUIRE(cDone);
+    REQUIRE(queue.size() == 0);
+}
+TEST_CASE("a blocked task does not hold back other consumers", "[tasks]")
+{
+    testBlockingTaskDoesNotHoldBackConsumers<tasks::threadsafe::SharedCounterRing>();
+    testBlockingTaskDoesNotHoldBackConsumers<tasks::threadsafe::SequencedRing>();
+}
+TEST_CASE("scheduler runs every posted task", "[tasks]")
+{
+    using TaskQueue =
+        tasks::threadsafe::Queue<void, 1024, 1 << 16, tasks::threadsafe::SequencedRing>;
+    TaskQueue queue;
+    tasks::Scheduler<TaskQueue> scheduler(queue, 2);
+
+    std::atomic<int> result{0};
+    tasks::CompletionCounter counter;
+    REQUIRE(queue.try_post_n(counter, 500, [&result](int64_t i) { result += int(i); }));
+    counter.wait();
+    REQUIRE(result == 500 * 499 / 2);
+}
+TEST_CASE("bulk post reserves and publishes a block of slots", "[tasks]")
+{
+    testBulkPost<tasks::threadsafe::SharedCounterRing>();
+    testBulkPost<tasks::threadsafe::SequencedRing>();
+}
+TEST_CASE("no memory is allocated in sequenced queue", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<int, 16, 4096, tasks::threadsafe::SequencedRing>;
+    TaskQueue queue;
+    alloc = 0;
+    memory = 0;
+
+    Foo foo;
+    auto future = queue.try_push(&Foo::sum, foo, 2, 3);
+    REQUIRE(future.valid());
+    REQUIRE(queue.size() == 1);
+    REQUIRE(queue.try_call_next());
+    REQUIRE(!queue.try_call_next());
+    REQUIRE(alloc == 0);
+    REQUIRE(memory == 0);
+    REQUIRE(future.get() == 5);
+}
+TEST_CASE("sequenced queue runs every task exactly once", "[tasks]")
+{
+    using TaskQueue =
+        tasks::threadsafe::Queue<void, 1024, 1 << 20, tasks::threadsafe::SequencedRing>;
+    TaskQueue queue;
+    const int producerCount = 4;
+    const int tasksPerProducer = 200;
+    std::atomic<int> result{0};
+    std::atomic<int> executed{0};
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < 2; i++)
+    {
+        consumers.emplace_back([&]() {
+            while (!done || queue.size() > 0)
+            {
+                if (queue.try_call_next())
+                    ++executed;
+            }
+        });
+    }
+    std::vector<std::thread> producers;
+    for (int p = 0; p < producerCount; p++)
+    {
+        producers.emplace_back([&, p]() {
+            for (int i = 0; i < tasksPerProducer; i++)
+            {
+                const int value = p * tasksPerProducer + i;
+                queue.try_push([&result, value]() { result += value; });
+            }
+        });
+    }
+    for (auto& t : producers)
+        t.join();
+    done = true;
+    for (auto& t : consumers)
+        t.join();
+
+    const int n = producerCount * tasksPerProducer;
+    REQUIRE(executed == n);
+    REQUIRE(result == n * (n - 1) / 2);
+}
+TEST_CASE("work-stealing deque is LIFO for the owner and FIFO for thieves", "[tasks]")
+{
+    tasks::threadsafe::WorkStealingDeque<int, 4> deque;
+    int value = 0;
+    REQUIRE(!deque.try_take(value));
+    REQUIRE(!deque.try_steal(value));
+    for (int i = 1; i <= 4; i++)
+        REQUIRE(deque.try_push(int(i)));
+    REQUIRE(!deque.try_push(5));
+    REQUIRE(deque.size() == 4);
+
+    REQUIRE(deque.try_take(value));
+    REQUIRE(value == 4);
+    REQUIRE(deque.try_steal(value));
+    REQUIRE(value == 1);
+    REQUIRE(deque.try_push(6));
+    REQUIRE(deque.try_push(7));
+    REQUIRE(deque.try_steal(value));
+    REQUIRE(value == 2);
+    REQUIRE(deque.try_take(value));
+    REQUIRE(value == 7);
+    REQUIRE(deque.size() == 2);
+}
+TEST_CASE("work-stealing deque hands every element out exactly once", "[tasks]")
+{
+    tasks::threadsafe::WorkStealingDeque<std::unique_ptr<int>, 64> deque;
+    const int n = 20000;
+    std::atomic<int64_t> sum{0};
+    std::atomic<int> count{0};
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < 2; i++)
+    {
+        thieves.emplace_back([&]() {
+            std::unique_ptr<int> value;
+            while (!done || deque.size() > 0)
+            {
+                if (deque.try_steal(value))
+                {
+                    sum += *value;
+                    ++count;
+                }
+            }
+        });
+    }
+    std::unique_ptr<int> value;
+    for (int i = 0; i < n; i++)
+    {
+        auto item = std::make_unique<int>(i);
+        while (!deque.try_push(std::move(item)))
+        {
+            if (deque.try_take(value))
+            {
+                sum += *value;
+                ++count;
+            }
+        }
+        if (i % 3 == 0 && deque.try_take(value))
+        {
+            sum += *value;
+            ++count;
+        }
+    }
+    done = true;
+    for (auto& t : thieves)
+        t.join();
+    while (deque.try_take(value))
+    {
+        sum += *value;
+        ++count;
+    }
+    REQUIRE(count == n);
+    REQUIRE(sum == int64_t(n) * (n - 1) / 2);
+}
+void spawnTree(tasks::Scheduler<tasks::threadsafe::Queue<void, 1024, 1 << 16>, 64>& scheduler,
+               tasks::CompletionCounter& counter,
+               std::atomic<int>& leaves,
+               int depth)
+{
+    if (depth == 0)
+    {
+        ++leaves;
+        return;
+    }
+    for (int i = 0; i < 2; i++)
+        scheduler.spawn(counter, [&scheduler, &counter, &leaves, depth]() {
+            spawnTree(scheduler, counter, leaves, depth - 1);
+        });
+}
+TEST_CASE("tasks spawned from inside tasks all run", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<void, 1024, 1 << 16>;
+    TaskQueue queue;
+    tasks::Scheduler<TaskQueue, 64> scheduler(queue, 4);
+
+    std::atomic<int> leaves{0};
+    tasks::CompletionCounter counter;
+    REQUIRE(scheduler.spawn(counter, [&]() { spawnTree(scheduler, counter, leaves, 10); }));
+    counter.wait();
+    REQUIRE(leaves == 1 << 10);
+}
+TEST_CASE("event count wakes a parked thread", "[tasks]")
+{
+    tasks::threadsafe::EventCount events;
+    std::atomic<bool> ready{false};
+
+    auto key = events.prepare_wait();
+    REQUIRE(events.waiters() == 1);
+    events.cancel_wait();
+    REQUIRE(events.waiters() == 0);
+    events.notify_one(); // nobody is waiting, nothing to do
+
+    std::thread waiter([&]() {
+        while (!ready)
+        {
+            key = events.prepare_wait();
+            if (ready)
+            {
+                events.cancel_wait();
+                break;
+            }
+            events.wait(key);
+        }
+    });
+    ready = true;
+    events.notify_one();
+    waiter.join();
+    REQUIRE(events.waiters() == 0);
+}
+TEST_CASE("scheduler runs tasks with every idle policy", "[tasks]")
+{
+    using namespace std::chrono_literals;
+    using TaskQueue =
+        tasks::threadsafe::Queue<void, 1024, 1 << 16, tasks::threadsafe::SequencedRing>;
+    TaskQueue queue;
+
+    for (auto policy :
+         {tasks::IdlePolicy::Spin, tasks::IdlePolicy::Yield, tasks::IdlePolicy::SpinThenPark})
+    {
+        tasks::SchedulerConfig config;
+        config.threadCount = 2;
+        config.idlePolicy  = policy;
+        config.spinCount   = 16;
+        tasks::Scheduler<TaskQueue> scheduler(queue, config);
+
+        std::atomic<int> result{0};
+        tasks::CompletionCounter counter;
+        for (int round = 0; round < 3; round++)
+        {
+            // give the workers time to go idle, and to park with SpinThenPark
+            std::this_thread::sleep_for(5ms);
+            REQUIRE(queue.try_post(counter, [&result]() { ++result; }));
+            REQUIRE(queue.try_post_n(counter, 10, [&result](int64_t) { ++result; }));
+            counter.wait();
+        }
+        REQUIRE(result == 33);
+    }
+}
+TEST_CASE("threads can be pinned to the available cpus", "[tasks]")
+{
+    const auto cpus = tasks::availableCpus();
+    REQUIRE(!cpus.empty());
+    bool pinned = false;
+    std::thread t([&]() { pinned = tasks::setThreadAffinity(nullptr, {cpus.front()}); });
+    t.join();
+#if __linux__
+    REQUIRE(pinned);
+#endif
+    REQUIRE(!tasks::setThreadAffinity(nullptr, {}));
+}
+TEST_CASE("scheduler pins its workers", "[tasks]")
+{
+    using TaskQueue =
+        tasks::threadsafe::Queue<void, 1024, 1 << 16, tasks::threadsafe::SequencedRing>;
+    TaskQueue queue;
+
+    for (auto affinity : {tasks::CpuAffinity::Spread, tasks::CpuAffinity::Explicit})
+    {
+        tasks::SchedulerConfig config;
+        config.threadCount = 2;
+        config.affinity    = affinity;
+        config.cpus        = {tasks::availableCpus().back()};
+        tasks::Scheduler<TaskQueue> scheduler(queue, config);
+
+        std::atomic<int> result{0};
+        tasks::CompletionCounter counter;
+        REQUIRE(queue.try_post_n(counter, 16, [&result](int64_t) { ++result; }));
+        counter.wait();
+        REQUIRE(result == 16);
+#if __linux__
+        REQUIRE(scheduler.configurationFailures() == 0);
+#endif
+    }
+}
+namespace
+{
+    void writeFile(const std::filesystem::path& path, const std::string& content)
+    {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream(path) << content;
+    }
+}
+TEST_CASE("cgroup cpu quotas limit the worker count", "[tasks]")
+{
+    namespace fs = std::filesystem;
+    const auto root = fs::temp_directory_path() / "tasks_cgroup_test";
+    fs::remove_all(root);
+    const auto proc = (root / "proc_cgroup").string();
+
+    // no cgroup information at all
+    REQUIRE(tasks::cgroupCpuLimit((root / "none").string(), (root / "missing").string()) == 0);
+
+    // cgroup v2, quota on a parent of the process cgroup
+    writeFile(root / "proc_cgroup", "0::/kubepods/pod1/container\n");
+    writeFile(root / "v2/kubepods/pod1/cpu.max", "400000 100000\n");
+    writeFile(root / "v2/kubepods/pod1/container/cpu.max", "max 100000\n");
+    REQUIRE(tasks::cgroupCpuLimit((root / "v2").string(), proc) == 4);
+
+    // cgroup v2 without quota
+    writeFile(root / "v2/kubepods/pod1/cpu.max", "max 100000\n");
+    REQUIRE(tasks::cgroupCpuLimit((root / "v2").string(), proc) == 0);
+
+    // cgroup v1 namespaced: the process path is not visible under the mount
+    writeFile(root / "proc_cgroup", "5:memory:/docker/abc\n4:cpu,cpuacct:/docker/abc\n");
+    writeFile(root / "v1/cpu,cpuacct/cpu.cfs_quota_us", "250000\n");
+    writeFile(root / "v1/cpu,cpuacct/cpu.cfs_period_us", "100000\n");
+    REQUIRE(tasks::cgroupCpuLimit((root / "v1").string(), proc) == 2);
+
+    // fractional quota still gets one cpu, -1 means unlimited
+    writeFile(root / "v1/cpu,cpuacct/cpu.cfs_quota_us", "50000\n");
+    REQUIRE(tasks::cgroupCpuLimit((root / "v1").string(), proc) == 1);
+    writeFile(root / "v1/cpu,cpuacct/cpu.cfs_quota_us", "-1\n");
+    REQUIRE(tasks::cgroupCpuLimit((root / "v1").string(), proc) == 0);
+
+    fs::remove_all(root);
+
+    const int concurrency = tasks::availableConcurrency();
+    REQUIRE(concurrency >= 1);
+    REQUIRE(concurrency <= int(tasks::availableCpus().size()));
+}
+TEST_CASE("numa topology is read from sysfs", "[tasks]")
+{
+    namespace fs = std::filesystem;
+    REQUIRE(tasks::numa::parseCpuList("0-3,8,10-11\n") == std::vector<int>{0, 1, 2, 3, 8, 10, 11});
+    REQUIRE(tasks::numa::parseCpuList("").empty());
+
+    const auto root = fs::temp_directory_path() / "tasks_numa_test";
+    fs::remove_all(root);
+    const auto cpus = tasks::availableCpus();
+    std::string list;
+    for (auto cpu : cpus)
+        list += (list.empty() ? "" : ",") + std::to_string(cpu);
+    writeFile(root / "node1/cpulist", list + "\n");
+    writeFile(root / "node3/cpulist", "4000-4001\n"); // not available to this process
+    writeFile(root / "online", "1,3\n");
+
+    auto nodes = tasks::numa::discoverTopology(root.string());
+    REQUIRE(nodes.size() == 1);
+    REQUIRE(nodes[0].id == 1);
+    REQUIRE(nodes[0].cpus == cpus);
+    REQUIRE(tasks::numa::currentNode(nodes) == 0);
+
+    nodes = tasks::numa::discoverTopology((root / "missing").string());
+    REQUIRE(nodes.size() == 1);
+    REQUIRE(nodes[0].cpus == cpus);
+    fs::remove_all(root);
+}
+TEST_CASE("numa scheduler runs the tasks of every node", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<int, 256, 1 << 16, tasks::threadsafe::SequencedRing>;
+    const auto cpus = tasks::availableCpus();
+    std::vector<tasks::numa::Node> topology(2);
+    topology[0].id = 0;
+    topology[0].cpus = {cpus.front()};
+    topology[1].id = 1;
+    topology[1].cpus = {cpus.back()};
+
+    tasks::SchedulerConfig config;
+    config.threadCount = 1;
+    tasks::NumaScheduler<TaskQueue> scheduler(config, topology);
+    REQUIRE(scheduler.nodeCount() == 2);
+
+    auto f0 = scheduler.queue(0).try_push([]() { return 1; });
+    auto f1 = scheduler.queue(1).try_push([]() { return 2; });
+    auto f2 = scheduler.localQueue().try_push([]() { return 3; });
+    REQUIRE(f0.get() + f1.get() + f2.get() == 6);
+    REQUIRE(scheduler.scheduler(0).configurationFailures() == 0);
+}
+TEST_CASE("parked workers poll remote queues", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<void, 64, 1 << 14>;
+    TaskQueue local;
+    TaskQueue remote;
+
+    tasks::SchedulerConfig config;
+    config.threadCount        = 1;
+    config.spinCount          = 0;
+    config.remotePollInterval = std::chrono::microseconds(500);
+    tasks::Scheduler<TaskQueue> scheduler(local, config, {&remote});
+    // let the worker park on its own, empty, queue
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    tasks::CompletionCounter counter;
+    REQUIRE(remote.try_post(counter, []() {}));
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!counter.done() && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    REQUIRE(counter.done());
+}
+TEST_CASE("arena pool gives every thread its own chunk", "[tasks]")
+{
+    using Pool = tasks::memory::ArenaMemoryPool<4096>;
+    static Pool pool;
+    const auto chunk = Pool::chunk_size;
+    REQUIRE(chunk == 256);
+
+    char* a = pool.allocate<8>(16);
+    char* b = pool.allocate<8>(10);
+    REQUIRE(b == a + 16);
+    REQUIRE(pool.used() == chunk);
+    pool.deallocate(b, 10);
+    REQUIRE(pool.allocate<8>(16) == b);
+
+    char* other = nullptr;
+    std::thread([&other]() { other = pool.allocate<8>(16); }).join();
+    REQUIRE(pool.owns(other));
+    REQUIRE(pool.used() == 2 * chunk);
+    REQUIRE((other >= a + chunk || other + chunk <= a));
+
+    char* large = pool.allocate<8>(chunk);
+    REQUIRE(pool.used() == 3 * chunk);
+    pool.deallocate(large, chunk);
+    REQUIRE(pool.used() == 2 * chunk);
+
+    pool.reset();
+    REQUIRE(pool.used() == 0);
+    char* fresh = pool.allocate<8>(16);
+    REQUIRE(pool.owns(fresh));
+    REQUIRE(pool.used() == chunk);
+}
+TEST_CASE("arena pool recycles chunks freed by other threads", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<void,
+                                               64,
+                                               1 << 16,
+                                               tasks::threadsafe::SharedCounterRing,
+                                               48,
+                                               tasks::memory::ArenaMemoryPool>;
+    TaskQueue queue;
+    const int taskCount = 4000;
+    std::atomic<int> sum{0};
+
+    // the producer allocates every task, the consumer releases them
+    std::thread producer([&queue, &sum]() {
+        for (int i = 0; i < taskCount; i++)
+        {
+            while (queue.size() >= 32)
+                std::this_thread::yield();
+            std::array<char, 200> capture{};
+            capture[0] = 1;
+            queue.try_post([capture, &sum]() { sum += capture[0]; });
+        }
+    });
+    int run = 0;
+    while (run < taskCount)
+    {
+        if (queue.try_call_next())
+            run++;
+        else
+            std::this_thread::yield();
+    }
+    producer.join();
+    REQUIRE(sum == taskCount);
+    REQUIRE(queue.memory_pool().used() == 0);
+}
+TEST_CASE("arena pool takes back the chunks of exited threads", "[tasks]")
+{
+    using Pool = tasks::memory::ArenaMemoryPool<1 << 16>;
+    static Pool pool;
+    REQUIRE(Pool::chunk_count == 16);
+
+    // far more threads than chunks, each one leaving a block for the next thread to release
+    char* last = nullptr;
+    for (int i = 0; i < 4 * int(Pool::chunk_count); i++)
+    {
+        std::thread([&last]() {
+            if (last)
+                pool.deallocate(last, 64);
+            char* p = pool.allocate<8>(32);
+            pool.deallocate(p, 32);
+            last = pool.allocate<8>(64);
+            REQUIRE(pool.owns(last));
+        }).join();
+    }
+    REQUIRE(pool.used() == Pool::chunk_size);
+    pool.deallocate(last, 64);
+    REQUIRE(pool.used() == 0);
+}
+TEST_CASE("queue allocates from an arena pool", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<int,
+                                               16,
+                                               1 << 14,
+                                               tasks::threadsafe::SharedCounterRing,
+                                               48,
+                                               tasks::memory::ArenaMemoryPool>;
+    TaskQueue queue;
+    alloc = 0;
+    memory = 0;
+
+    Foo foo;
+    auto future = queue.try_push(&Foo::sum, foo, 20, 22);
+    REQUIRE(queue.try_call_next());
+    REQUIRE(future.get() == 42);
+    REQUIRE(alloc == 0);
+    REQUIRE(memory == 0);
+}
+TEST_CASE("slab pool recycles blocks released in any order", "[tasks]")
+{
+    using Pool = tasks::memory::SlabMemoryPool<8192>;
+    static Pool pool;
+    REQUIRE(Pool::min_block_size == 16);
+    REQUIRE(Pool::max_block_size == 1024);
+
+    char* a = pool.allocate<8>(10);
+    char* b = pool.allocate<8>(16);
+    char* c = pool.allocate<8>(100);
+    REQUIRE(pool.used() == 16 + 16 + 128);
+
+    // out of order release, the blocks come back in LIFO order per size class
+    pool.deallocate(a, 10);
+    pool.deallocate(c, 100);
+    pool.deallocate(b, 16);
+    REQUIRE(pool.allocate<8>(12) == b);
+    REQUIRE(pool.allocate<8>(16) == a);
+    REQUIRE(pool.allocate<8>(65) == c);
+    REQUIRE(pool.used() == 16 + 16 + 128);
+
+    // steady state churn stays inside the buffer
+    std::vector<char*> blocks;
+    for (int round = 0; round < 1000; round++)
+    {
+        for (int i = 0; i < 8; i++)
+            blocks.push_back(pool.allocate<8>(48));
+        for (size_t i = 0; i < blocks.size(); i += 2)
+            pool.deallocate(blocks[i], 48);
+        for (size_t i = 1; i < blocks.size(); i += 2)
+            pool.deallocate(blocks[i], 48);
+        blocks.clear();
+    }
+    REQUIRE(pool.used() == 16 + 16 + 128 + 8 * 64);
+    pool.reset();
+    REQUIRE(pool.used() == 0);
+}
+TEST_CASE("slab pool hands out disjoint blocks under contention", "[tasks]")
+{
+    using Pool = tasks::memory::SlabMemoryPool<1 << 20>;
+    static Pool pool;
+    std::atomic<int> corrupted{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&corrupted, t]() {
+            std::vector<std::pair<char*, size_t>> blocks;
+            for (int i = 0; i < 20000; i++)
+            {
+                const size_t n = 16 + (i * 7 + t) % 200;
+                char* p = pool.allocate<8>(n);
+                std::memset(p, t + 1, n);
+                blocks.emplace_back(p, n);
+                if (blocks.size() > 16)
+                {
+                    auto [q, m] = blocks[(i * 13) % blocks.size()];
+                    for (size_t k = 0; k < m; k++)
+                        if (q[k] != char(t + 1))
+                            ++corrupted;
+                    pool.deallocate(q, m);
+                    blocks[(i * 13) % blocks.size()] = blocks.back();
+                    blocks.pop_back();
+                }
+            }
+            for (auto [q, m] : blocks)
+                pool.deallocate(q, m);
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    REQUIRE(corrupted == 0);
+    REQUIRE(pool.used() < Pool::size() / 2);
+}
+TEST_CASE("queue on a slab pool runs indefinitely inside its budget", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<int,
+                                               64,
+                                               1 << 14,
+                                               tasks::threadsafe::SequencedRing,
+                                               48,
+                                               tasks::memory::SlabMemoryPool>;
+    TaskQueue queue;
+    tasks::Scheduler<TaskQueue> scheduler(queue, 2);
+
+    // far more tasks than the 16 KiB pool could hold without recycling
+    std::vector<std::future<int>> futures;
+    int64_t sum = 0;
+    for (int i = 0; i < 5000; i++)
+    {
+        futures.emplace_back(queue.try_push([i]() { return i; }));
+        if (futures.size() == 32)
+        {
+            for (auto& f : futures)
+                sum += f.get();
+            futures.clear();
+        }
+    }
+    for (auto& f : futures)
+        sum += f.get();
+    REQUIRE(sum == int64_t(5000) * 4999 / 2);
+}
+TEST_CASE("chained pool grows by whole chunks up to its limit", "[tasks]")
+{
+    using Pool = tasks::memory::ChainedMemoryPool<4096>;
+    Pool pool;
+    pool.set_chunk_limit(3);
+    std::vector<tasks::memory::GrowthEvent> events;
+    events.reserve(8);
+    pool.set_growth_handler(
+        [&events](const tasks::memory::GrowthEvent& e) { events.push_back(e); });
+
+    std::vector<char*> blocks;
+    blocks.reserve(16);
+    const auto heapBytes = memory;
+    for (int i = 0; i < 3 * 4096 / 1024; i++)
+        blocks.push_back(pool.allocate<8>(1024));
+    REQUIRE(memory == heapBytes);
+    REQUIRE(pool.chunk_count() == 3);
+    REQUIRE(pool.growth_count() == 2);
+    REQUIRE(events.size() == 2);
+    REQUIRE(events[1].chunks == 3);
+    REQUIRE(events[1].capacity == 3 * 4096);
+    for (auto* p : blocks)
+        REQUIRE(pool.owns(p));
+
+    // every chunk is full and the limit is reached
+    REQUIRE(pool.try_allocate<8>(16) == nullptr);
+    REQUIRE_THROWS_AS(pool.allocate<8>(16), std::bad_alloc);
+
+    // a chunk whose blocks are all released, in any order, is reused without growing
+    pool.deallocate(blocks[5], 1024);
+    pool.deallocate(blocks[4], 1024);
+    pool.deallocate(blocks[7], 1024);
+    REQUIRE(pool.try_allocate<8>(16) == nullptr);
+    pool.deallocate(blocks[6], 1024);
+    REQUIRE(pool.used() == 2 * 4096);
+    REQUIRE(pool.allocate<8>(16) == blocks[4]);
+    REQUIRE(pool.chunk_count() == 3);
+    REQUIRE(events.size() == 2);
+}
+TEST_CASE("chained pool reserves chunks up front", "[tasks]")
+{
+    tasks::memory::ChainedMemoryPool<4096> pool;
+    pool.set_chunk_limit(4);
+    REQUIRE(pool.reserve(8) == 4);
+    REQUIRE(pool.capacity() == 4 * 4096);
+    for (int i = 0; i < 16; i++)
+        pool.allocate<8>(1000);
+    REQUIRE(pool.growth_count() == 0);
+}
+TEST_CASE("queue on a chained pool absorbs bursts", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<int,
+                                               1024,
+                                               1 << 14,
+                                               tasks::threadsafe::SequencedRing,
+                                               48,
+                                               tasks::memory::ChainedMemoryPool>;
+    TaskQueue::memory_pool_type pool;
+    pool.set_chunk_limit(16);
+    TaskQueue queue(pool);
+
+    // the burst of shared states outgrows the internal buffer, nothing is running the tasks yet
+    std::vector<std::future<int>> futures;
+    for (int i = 0; i < 1000; i++)
+        futures.emplace_back(queue.try_push([i]() { return i; }));
+    REQUIRE(pool.growth_count() > 0);
+    while (queue.try_call_next())
+    {
+    }
+    int64_t sum = 0;
+    for (auto& f : futures)
+        sum += f.get();
+    REQUIRE(sum == int64_t(1000) * 999 / 2);
+    futures.clear();
+    // the consumer destroyed every task, so the futures were the last users of the pool
+    REQUIRE(pool.used() == 0);
+}
+TEST_CASE("queues own separate pools", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<int, 512, 65536>;
+    TaskQueue first;
+    TaskQueue second;
+    REQUIRE(&first.memory_pool() != &second.memory_pool());
+
+    auto f = first.try_push([]() { return 1; });
+    REQUIRE(first.memory_pool().used() > 0);
+    REQUIRE(second.memory_pool().used() == 0);
+    first.try_call_next();
+    REQUIRE(f.get() == 1);
+
+    // queues built on one pool share it
+    auto pool = std::make_unique<TaskQueue::memory_pool_type>();
+    TaskQueue third(*pool);
+    TaskQueue fourth(*pool);
+    REQUIRE(&third.memory_pool() == pool.get());
+    REQUIRE(&fourth.memory_pool() == pool.get());
+}
+TEST_CASE("queue pool size can be chosen at runtime", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<int,
+                                               256,
+                                               4096,
+                                               tasks::threadsafe::SharedCounterRing,
+                                               48,
+                                               tasks::memory::DynamicMemoryPool>;
+    TaskQueue small;
+    REQUIRE(small.memory_pool().size() == 4096);
+
+    TaskQueue queue(std::in_place, std::size_t(1) << 20);
+    REQUIRE(queue.memory_pool().size() == std::size_t(1) << 20);
+    std::vector<std::future<int>> futures;
+    for (int i = 0; i < 200; i++)
+        futures.emplace_back(queue.try_push([i]() { return i; }));
+    REQUIRE(queue.memory_pool().used() > 4096);
+    while (queue.try_call_next())
+    {
+    }
+    int sum = 0;
+    for (auto& f : futures)
+        sum += f.get();
+    REQUIRE(sum == 200 * 199 / 2);
+}
+TEST_CASE("dynamic pool starts over once every block is released", "[tasks]")
+{
+    tasks::memory::DynamicMemoryPool<1024> pool(256);
+    REQUIRE(pool.size() == 256);
+    char* a = pool.allocate<8>(100);
+    char* b = pool.allocate<8>(100);
+    REQUIRE_THROWS_AS(pool.allocate<8>(100), std::bad_alloc);
+    pool.deallocate(a, 100);
+    REQUIRE(pool.try_allocate<8>(100) == nullptr);
+    pool.deallocate(b, 100);
+    REQUIRE(pool.used() == 0);
+    REQUIRE(pool.allocate<8>(100) == a);
+}
+TEST_CASE("locked pool maps its buffer up front", "[tasks]")
+{
+    const auto mapping = tasks::memory::mapPages(10000, tasks::memory::PageOptions::realtime());
+    REQUIRE(mapping.data != nullptr);
+    REQUIRE(mapping.bytes >= 10000);
+    REQUIRE(mapping.bytes % tasks::memory::pageSize() == 0);
+    REQUIRE(mapping.populated);
+    tasks::memory::unmapPages(mapping);
+
+    using TaskQueue = tasks::threadsafe::Queue<int,
+                                               64,
+                                               1 << 16,
+                                               tasks::threadsafe::SequencedRing,
+                                               48,
+                                               tasks::memory::LockedMemoryPool>;
+    TaskQueue queue;
+    REQUIRE(queue.memory_pool().mapping().populated);
+    tasks::Scheduler<TaskQueue> scheduler(queue, 2);
+    auto f = queue.try_push([]() { return 42; });
+    REQUIRE(f.get() == 42);
+}
+TEST_CASE("pools hand out over-aligned blocks", "[tasks]")
+{
+    struct alignas(64) Line
+    {
+        int value[16];
+    };
+    tasks::memory::Allocator<Line, 4096, 64> allocator;
+    auto* a = allocator.allocate(1);
+    auto* b = allocator.allocate(1);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(a) % 64 == 0);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(b) % 64 == 0);
+    allocator.deallocate(b, 1);
+    allocator.deallocate(a, 1);
+
+    static tasks::memory::MemoryPool<1 << 16, 4096> pagePool;
+    char* page = pagePool.allocate<4096>(100);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(page) % 4096 == 0);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(pagePool.allocate<8>(1)) % 4096 == 0);
+
+    static tasks::memory::SlabMemoryPool<1 << 16, 256> slab;
+    REQUIRE(reinterpret_cast<std::uintptr_t>(slab.allocate<256>(10)) % 256 == 0);
+}
+TEST_CASE("cache line padded queue keeps task state on separate lines", "[tasks]")
+{
+    using TaskQueue =
+        tasks::threadsafe::Queue<int,
+                                 64,
+                                 1 << 14,
+                                 tasks::threadsafe::SequencedRing,
+                                 48,
+                                 tasks::memory::CacheLinePadded<tasks::memory::MemoryPool>::type>;
+    TaskQueue queue;
+    static_assert(TaskQueue::memory_pool_type::size() == 1 << 14);
+
+    // every allocation starts a fresh cache line
+    auto before = queue.memory_pool().used();
+    auto f      = queue.try_push([]() { return 1; });
+    auto after  = queue.memory_pool().used();
+    REQUIRE((after - before) % tasks::memory::cache_line_size == 0);
+
+    // an over-aligned callable is stored out of line in the 64 byte aligned pool
+    struct alignas(64) Aligned
+    {
+        int value{7};
+    };
+    Aligned aligned;
+    auto g = queue.try_push([aligned]() {
+        REQUIRE(reinterpret_cast<std::uintptr_t>(&aligned) % 64 == 0);
+        return aligned.value;
+    });
+    while (queue.try_call_next())
+    {
+    }
+    REQUIRE(f.get() == 1);
+    REQUIRE(g.get() == 7);
+}
+TEST_CASE("pmr containers allocate from a pool resource", "[tasks]")
+{
+    static tasks::memory::MemoryPool<1 << 14> pool;
+    tasks::memory::PoolResource<tasks::memory::MemoryPool<1 << 14>> resource(pool);
+    const auto heapBytes = memory;
+    {
+        std::pmr::vector<int> values(&resource);
+        for (int i = 0; i < 100; i++)
+            values.push_back(i);
+        std::pmr::string text("a string that does not fit the small buffer", &resource);
+        REQUIRE(pool.owns(reinterpret_cast<const char*>(values.data())));
+        REQUIRE(pool.owns(text.data()));
+    }
+    REQUIRE(memory == heapBytes);
+    REQUIRE(resource.is_equal(resource));
+    REQUIRE_THROWS_AS(resource.allocate(64, 64), std::bad_alloc);
+
+    tasks::memory::SlabMemoryPool<1 << 14> slab;
+    tasks::memory::PoolResource<tasks::memory::SlabMemoryPool<1 << 14>> slabResource(slab);
+    std::pmr::vector<int> values({1, 2, 3}, &slabResource);
+    REQUIRE(slab.owns(reinterpret_cast<const char*>(values.data())));
+}
+TEST_CASE("tasks get per-worker scratch memory from the scheduler", "[tasks]")
+{
+    // the slab pool takes back the chunks the scratch resources release after every task
+    using TaskQueue = tasks::threadsafe::Queue<void,
+                                               256,
+                                               1 << 18,
+                                               tasks::threadsafe::SequencedRing,
+                                               48,
+                                               tasks::memory::SlabMemoryPool>;
+    TaskQueue queue;
+    tasks::SchedulerConfig config;
+    config.threadCount = 2;
+    config.scratchSize = 4096;
+    tasks::Scheduler<TaskQueue> scheduler(queue, config);
+    REQUIRE(scheduler.scratch_resource() == std::pmr::get_default_resource());
+
+    std::atomic<int> fromPool{0};
+    std::atomic<int64_t> total{0};
+    tasks::CompletionCounter counter;
+    for (int t = 0; t < 64; t++)
+    {
+        scheduler.spawn(counter, [&, t]() {
+            std::pmr::vector<int> values(scheduler.scratch_resource());
+            for (int i = 0; i <= t; i++)
+                values.push_back(i);
+            // grows past the scratch buffer into the queue's pool
+            std::pmr::vector<char> large(8192, 'x', scheduler.scratch_resource());
+            if (queue.memory_pool().owns(reinterpret_cast<const char*>(values.data())) &&
+                queue.memory_pool().owns(large.data()))
+                ++fromPool;
+            int64_t sum = 0;
+            for (auto v : values)
+                sum += v;
+            total += sum;
+        });
+    }
+    counter.wait();
+    REQUIRE(fromPool == 64);
+    REQUIRE(total == 63 * 64 * 65 / 6);
+
+    std::pmr::vector<int> shared({1, 2, 3}, scheduler.memory_resource());
+    REQUIRE(queue.memory_pool().owns(reinterpret_cast<const char*>(shared.data())));
+}
+TEST_CASE("epoch pool resets an epoch once its last block is released", "[tasks]")
+{
+    using Pool = tasks::memory::EpochMemoryPool<4096>;
+    static Pool pool;
+    REQUIRE(Pool::arena_size == 1024);
+    REQUIRE(pool.current_epoch() == 0);
+
+    char* a = pool.allocate<8>(100);
+    char* b = pool.allocate<8>(100);
+    REQUIRE(b == a + 112);
+    REQUIRE(pool.try_advance());
+    REQUIRE(pool.current_epoch() == 1);
+    REQUIRE(!pool.is_quiescent(0));
+
+    // the new epoch allocates from its own arena
+    char* c = pool.allocate<8>(100);
+    REQUIRE(c == a + Pool::arena_size);
+    pool.deallocate(b, 100);
+    REQUIRE(!pool.is_quiescent(0));
+    pool.deallocate(a, 100);
+    REQUIRE(pool.is_quiescent(0));
+
+    // epoch 4 reuses the arena of epoch 0, but epoch 1 still holds c
+    REQUIRE(pool.try_advance());
+    REQUIRE(pool.try_advance());
+    REQUIRE(pool.try_advance());
+    REQUIRE(pool.allocate<8>(16) == a);
+    REQUIRE(!pool.try_advance());
+    pool.deallocate(c, 100);
+    REQUIRE(pool.try_advance());
+    REQUIRE(pool.current_epoch() == 5);
+    REQUIRE(pool.is_quiescent(1));
+    REQUIRE(!pool.is_quiescent(4));
+
+    // an open epoch is never reset, even when all its blocks are gone
+    char* d = pool.allocate<8>(16);
+    pool.deallocate(d, 16);
+    REQUIRE(pool.allocate<8>(16) == d + 16);
+}
+TEST_CASE("frames of tasks reclaim their epoch arena", "[tasks]")
+{
+    // every task is stored out of line, in the arena of the frame that submitted it
+    using TaskQueue = tasks::threadsafe::Queue<void,
+                                               64,
+                                               1 << 16,
+                                               tasks::threadsafe::SequencedRing,
+                                               16,
+                                               tasks::memory::EpochMemoryPool>;
+    TaskQueue queue;
+    auto& pool = queue.memory_pool();
+    tasks::Scheduler<TaskQueue> scheduler(queue, 2);
+
+    std::atomic<int64_t> sum{0};
+    for (int frame = 0; frame < 200; frame++)
+    {
+        tasks::CompletionCounter counter;
+        std::array<int64_t, 4> payload{frame, frame, frame, frame};
+        for (int i = 0; i < 64; i++)
+            queue.try_post(counter, [&sum, payload]() { sum += payload[0]; });
+        counter.wait();
+        pool.advance();
+        // the counter is done before the last consumer unpins the frame, which follows shortly
+        while (!pool.is_quiescent(uint64_t(frame)))
+            std::this_thread::yield();
+        REQUIRE(pool.current_epoch() == uint64_t(frame + 1));
+    }
+    REQUIRE(sum == int64_t(64) * 199 * 200 / 2);
+}
+TEST_CASE("queued tasks hold their epoch until they have run", "[tasks]")
+{
+    // the tasks fit inline and allocate nothing from the pool
+    using TaskQueue = tasks::threadsafe::Queue<void,
+                                               64,
+                                               1 << 16,
+                                               tasks::threadsafe::SequencedRing,
+                                               64,
+                                               tasks::memory::EpochMemoryPool>;
+    static_assert(TaskQueue::pins_epochs, "epoch pools are pinned by their queue");
+    TaskQueue queue;
+    auto& pool = queue.memory_pool();
+
+    int runs         = 0;
+    const auto epoch = pool.current_epoch();
+    for (int i = 0; i < 8; i++)
+        REQUIRE(queue.try_post([&runs]() { runs++; }));
+    REQUIRE(queue.try_post_n(8, [&runs](int64_t) { runs++; }));
+    REQUIRE(pool.used() == 0);
+    pool.advance();
+    REQUIRE(!pool.is_quiescent(epoch));
+
+    while (runs < 15)
+        REQUIRE(queue.try_call_next());
+    REQUIRE(!pool.is_quiescent(epoch));
+    REQUIRE(queue.try_call_next_n(TaskQueue::max_batch_size) == 1);
+    REQUIRE(runs == 16);
+    REQUIRE(pool.is_quiescent(epoch));
+
+    // a pin of its own keeps the epoch open past its tasks
+    const auto pinned = pool.pin();
+    REQUIRE(queue.try_post([&runs]() { runs++; }));
+    pool.advance();
+    REQUIRE(queue.try_call_next());
+    REQUIRE(!pool.is_quiescent(pinned));
+    pool.unpin(pinned);
+    REQUIRE(pool.is_quiescent(pinned));
+}
+TEST_CASE("queue recycles shared states through its free list", "[tasks]")
+{
+    using Recycling = tasks::memory::Recycling<tasks::memory::MemoryPool, 128, 512>;
+    using TaskQueue = tasks::threadsafe::Queue<int,
+                                               64,
+                                               4096,
+                                               tasks::threadsafe::SequencedRing,
+                                               48,
+                                               Recycling::type>;
+    TaskQueue queue;
+    auto& pool = queue.memory_pool();
+    REQUIRE(pool.block_size == 128);
+
+    const auto heapBytes = memory;
+    int64_t sum          = 0;
+    for (int i = 0; i < 10000; i++)
+    {
+        auto f = queue.try_push([i]() { return i; });
+        queue.try_call_next();
+        sum += f.get();
+    }
+    REQUIRE(sum == int64_t(10000) * 9999 / 2);
+    REQUIRE(memory == heapBytes);
+    // the pool behind was never needed, and only the blocks of the states alive at once were used
+    REQUIRE(pool.used() == 0);
+    REQUIRE(pool.blocks_touched() <= 2 * (64 + 1));
+
+    // larger requests go to the pool behind
+    char* large = pool.allocate<8>(1000);
+    REQUIRE(pool.pool().owns(large));
+    pool.deallocate(large, 1000);
+}
+TEST_CASE("recycling pool hands blocks back across threads", "[tasks]")
+{
+    using Pool =
+        tasks::memory::Recycling<tasks::memory::SlabMemoryPool, 64, 256>::type<1 << 16, 16>;
+    static Pool pool;
+    std::atomic<int> corrupted{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&corrupted, t]() {
+            for (int i = 0; i < 20000; i++)
+            {
+                char* p = pool.allocate<8>(64);
+                std::memset(p, t, 64);
+                std::this_thread::yield();
+                if (p[63] != char(t))
+                    ++corrupted;
+                pool.deallocate(p, 64);
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    REQUIRE(corrupted == 0);
+    REQUIRE(pool.blocks_touched() <= 4);
+    REQUIRE(pool.used() == 0);
+}
+TEST_CASE("consumers destroy tasks right after running them", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<void, 16, 4096>;
+    TaskQueue queue;
+    auto token = std::make_shared<int>(0);
+
+    queue.try_post([token]() { ++*token; });
+    queue.try_post([token]() { ++*token; });
+    REQUIRE(token.use_count() == 3);
+    REQUIRE(queue.try_call_next());
+    REQUIRE(token.use_count() == 2);
+    REQUIRE(queue.try_call_next_n(8) == 1);
+    REQUIRE(token.use_count() == 1);
+    REQUIRE(*token == 2);
+
+    // the promise inside a finished task is gone, only the future holds the shared state
+    using IntQueue = tasks::threadsafe::Queue<int, 16, 4096>;
+    IntQueue intQueue;
+    auto before = intQueue.memory_pool().used();
+    {
+        auto f = intQueue.try_push([]() { return 3; });
+        intQueue.try_call_next();
+        REQUIRE(f.get() == 3);
+    }
+    REQUIRE(intQueue.memory_pool().used() == before);
+}
+TEST_CASE("move-only arguments are moved into the task", "[tasks]")
+{
+    struct Payload
+    {
+        std::vector<int> data;
+        int* copies;
+        Payload(std::vector<int> d, int* c)
+        : data(std::move(d))
+        , copies(c)
+        {
+        }
+        Payload(const Payload& other)
+        : data(other.data)
+        , copies(other.copies)
+        {
+            ++*copies;
+        }
+        Payload(Payload&&) noexcept = default;
+    };
+
+    using TaskQueue = tasks::threadsafe::Queue<int, 16, 1 << 14>;
+    TaskQueue queue;
+
+    auto f = queue.try_push([](std::unique_ptr<int> p, int offset) { return *p + offset; },
+                            std::make_unique<int>(40),
+                            2);
+    auto owned = std::make_unique<int>(7);
+    auto g     = queue.try_push([p = std::move(owned)]() { return *p; });
+
+    int copies = 0;
+    Payload payload(std::vector<int>(1000, 1), &copies);
+    const int* data = payload.data.data();
+    auto h          = queue.try_push(
+        [data](Payload p) { return p.data.data() == data ? int(p.data.size()) : -1; },
+        std::move(payload));
+
+    tasks::CompletionCounter counter;
+    int sum = 0;
+    queue.try_post(
+        counter, [&sum](std::unique_ptr<int> p) { sum += *p; }, std::make_unique<int>(5));
+
+    while (queue.try_call_next())
+    {
+    }
+    REQUIRE(f.get() == 42);
+    REQUIRE(g.get() == 7);
+    REQUIRE(h.get() == 1000);
+    REQUIRE(copies == 0);
+    REQUIRE(counter.done());
+    REQUIRE(sum == 5);
+}
+TEST_CASE("one queue and scheduler run callables of any return type", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<void, 256, 1 << 16>;
+    TaskQueue queue;
+
+    auto a = queue.try_submit([](int x) { return x * 2; }, 21);
+    auto b = queue.try_submit([]() { return std::string("tasks"); });
+    static_assert(std::is_same<decltype(a), std::future<int>>::value, "");
+    static_assert(std::is_same<decltype(b), std::future<std::string>>::value, "");
+    while (queue.try_call_next())
+    {
+    }
+    REQUIRE(a.get() == 42);
+    REQUIRE(b.get() == "tasks");
+
+    tasks::Scheduler<TaskQueue> scheduler(queue, 2);
+    std::atomic<int> calls{0};
+    auto i = scheduler.submit([](int x) { return x + 1; }, 1);
+    auto f = scheduler.submit([](float x) { return x * 0.5f; }, 3.0f);
+    auto v = scheduler.submit([&calls]() { calls++; });
+    auto e = scheduler.submit([]() -> double { throw std::runtime_error("failed"); });
+    // from inside a worker the task goes to the local deque
+    auto nested =
+        scheduler.submit([&scheduler]() { return scheduler.submit([]() { return 7L; }); });
+    REQUIRE(i.get() == 2);
+    REQUIRE(f.get() == 1.5f);
+    v.get();
+    REQUIRE(calls == 1);
+    REQUIRE_THROWS_AS(e.get(), std::runtime_error);
+    REQUIRE(nested.get().get() == 7L);
+}
+TEST_CASE("lightweight futures chain continuations on the scheduler", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<void,
+                                               256,
+                                               1 << 18,
+                                               tasks::threadsafe::SharedCounterRing,
+                                               48,
+                                               tasks::memory::SlabMemoryPool>;
+    TaskQueue queue;
+
+    {
+        tasks::Promise<int> promise;
+        auto future = promise.get_future();
+        REQUIRE(!future.is_ready());
+        std::thread setter([&promise]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            promise.set_value(5);
+        });
+        // spins for a few rounds only, then parks until the value is set
+        future.wait(16);
+        REQUIRE(future.get() == 5);
+        REQUIRE(!future.valid());
+        setter.join();
+    }
+    {
+        tasks::Future<void> broken;
+        {
+            tasks::Promise<void> promise;
+            broken = promise.get_future();
+        }
+        REQUIRE_THROWS_AS(broken.get(), std::future_error);
+    }
+
+    const auto carved = queue.memory_pool().used();
+    {
+        tasks::Scheduler<TaskQueue> scheduler(queue, 2);
+        auto answer = scheduler.async([](int x) { return x * 2; }, 20)
+                          .then(scheduler, [](int x) { return x + 2; })
+                          .then(scheduler, [](int x) { return std::to_string(x); });
+        REQUIRE(answer.get() == "42");
+        REQUIRE(queue.memory_pool().used() > carved);
+
+        std::atomic<int> calls{0};
+        auto done =
+            scheduler.async([&calls]() { calls++; }).then(scheduler, [&calls]() { calls++; });
+        done.get();
+        REQUIRE(calls == 2);
+
+        // an exception skips the continuations and ends up in the last future
+        auto failed = scheduler.async([]() -> int { throw std::runtime_error("failed"); })
+                          .then(scheduler, [&calls](int x) {
+                              calls++;
+                              return x;
+                          });
+        REQUIRE_THROWS_AS(failed.get(), std::runtime_error);
+        REQUIRE(calls == 2);
+
+        // continuation installed after the value was set
+        auto ready = scheduler.async([]() { return 1; });
+        ready.wait();
+        REQUIRE(std::move(ready).then(scheduler, [](int x) { return x + 1; }).get() == 2);
+    }
+}
+TEST_CASE("a full queue runs async tasks and continuations inline", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<void, 8, 1 << 16>;
+    TaskQueue queue;
+    tasks::Scheduler<TaskQueue> scheduler(queue, 1);
+
+    // hold the only worker, then fill the queue behind it
+    std::atomic<bool> started{false}, release{false};
+    std::atomic<int> filled{0};
+    REQUIRE(queue.try_post([&started, &release]() {
+        started = true;
+        while (!release)
+            std::this_thread::yield();
+    }));
+    while (!started)
+        std::this_thread::yield();
+    int queued = 0;
+    while (queue.try_post_task(queue.make_task([&filled]() { filled++; })))
+        queued++;
+    CHECK(queued > 0);
+
+    // checks only until the worker is released, a failure must not leave it blocked
+    auto value = scheduler.async([]() { return 7; });
+    CHECK(value.is_ready());
+    CHECK(value.get() == 7);
+
+    tasks::Promise<int> promise;
+    auto next = promise.get_future().then(scheduler, [](int v) { return v + 1; });
+    promise.set_value(1);
+    CHECK(next.is_ready());
+    CHECK(next.get() == 2);
+
+    release = true;
+    while (filled < queued)
+        std::this_thread::yield();
+}
+TEST_CASE("when_all and when_any complete on a countdown", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<void,
+                                               256,
+                                               1 << 18,
+                                               tasks::threadsafe::SharedCounterRing,
+                                               48,
+                                               tasks::memory::SlabMemoryPool>;
+    TaskQueue queue;
+    tasks::Scheduler<TaskQueue> scheduler(queue, 2);
+
+    std::vector<tasks::Future<int>> futures;
+    for (int i = 0; i < 64; i++)
+        futures.emplace_back(scheduler.async([](int x) { return x; }, i));
+    // the state and the result come from the scheduler's memory resource
+    const auto heapBytes = memory;
+    auto allFuture       = tasks::when_all(scheduler, futures.begin(), futures.end());
+    REQUIRE(memory == heapBytes);
+    auto all = allFuture.get();
+    REQUIRE(all.size() == 64);
+    REQUIRE(all.get_allocator().resource() == scheduler.memory_resource());
+    int sum = 0;
+    for (auto& f : all)
+    {
+        REQUIRE(f.is_ready());
+        sum += f.get();
+    }
+    REQUIRE(sum == 63 * 64 / 2);
+
+    auto mixed = tasks::when_all(scheduler,
+                                 scheduler.async([]() { return 1; }),
+                                 scheduler.async([]() { return std::string("two"); }),
+                                 scheduler.async([]() {}))
+                     .get();
+    REQUIRE(std::get<0>(mixed).get() == 1);
+    REQUIRE(std::get<1>(mixed).get() == "two");
+    std::get<2>(mixed).get();
+
+    tasks::Promise<int> never;
+    tasks::Promise<int> first;
+    auto any = tasks::when_any(scheduler, never.get_future(), first.get_future());
+    REQUIRE(!any.is_ready());
+    first.set_value(3);
+    auto winner = any.get();
+    REQUIRE(winner.index == 1);
+    REQUIRE(std::get<1>(winner.futures).get() == 3);
+    never.set_value(4);
+    REQUIRE(std::get<0>(winner.futures).get() == 4);
+
+    std::vector<tasks::Future<int>> none;
+    REQUIRE(tasks::when_all(none.begin(), none.end()).get().empty());
+    REQUIRE(tasks::when_any(none.begin(), none.end()).get().index == std::size_t(-1));
+    REQUIRE(tasks::when_any(scheduler, none.begin(), none.end()).get().futures.empty());
+
+    // a failed future is handed back in the result, when_all itself still completes
+    auto failed =
+        tasks::when_all(scheduler.async([]() -> int { throw std::runtime_error("failed"); }))
+            .get();
+    REQUIRE_THROWS_AS(std::get<0>(failed).get(), std::runtime_error);
+}
+TEST_CASE("task graph runs nodes after their predecessors, again and again", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<void, 256, 1 << 16>;
+    TaskQueue queue;
+    tasks::Scheduler<TaskQueue, 64> scheduler(queue, 2);
+
+    // a -> b, c -> d, and a fan of 32 nodes between c and d
+    std::atomic<int> a{0}, b{0}, c{0}, d{0}, fan{0};
+    std::atomic<bool> ordered{true};
+    tasks::TaskGraph graph;
+    graph.reserve(36);
+    const auto na = graph.add_node([&]() { a++; });
+    const auto nb = graph.add_node([&]() {
+        ordered = ordered && b + 1 == a;
+        b++;
+    });
+    const auto nc = graph.add_node([&]() {
+        ordered = ordered && c + 1 == a;
+        c++;
+    });
+    const auto nd = graph.add_node([&]() {
+        ordered = ordered && d + 1 == b && d + 1 == c && fan == 32 * (d + 1);
+        d++;
+    });
+    graph.add_edge(na, nb);
+    graph.add_edge(na, nc);
+    graph.add_edge(nb, nd);
+    graph.add_edge(nc, nd);
+    for (int i = 0; i < 32; i++)
+    {
+        const auto n = graph.add_node([&]() {
+            ordered = ordered && c > fan / 32;
+            fan++;
+        });
+        graph.add_edge(nc, n);
+        graph.add_edge(n, nd);
+    }
+    REQUIRE(graph.size() == 36);
+
+    graph.run_and_wait(scheduler);
+    REQUIRE(d == 1);
+
+    const auto allocated = memory;
+    for (int run = 0; run < 10; run++)
+        graph.run_and_wait(scheduler);
+    REQUIRE(memory == allocated);
+    REQUIRE(a == 11);
+    REQUIRE(d == 11);
+    REQUIRE(fan == 32 * 11);
+    REQUIRE(ordered);
+
+    tasks::TaskGraph empty;
+    empty.run_and_wait(scheduler);
+    REQUIRE(empty.done());
+
+    // wait() parks until the last node of a slow run has finished
+    tasks::TaskGraph slow;
+    std::atomic<bool> finished{false};
+    slow.add_node([&finished]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        finished = true;
+    });
+    for (int run = 0; run < 3; run++)
+    {
+        finished = false;
+        slow.run_and_wait(scheduler);
+        REQUIRE(finished);
+    }
+
+    // the graph may be destroyed as soon as wait() returns
+    for (int run = 0; run < 200; run++)
+    {
+        auto graph = std::make_unique<tasks::TaskGraph>();
+        std::atomic<int> count{0};
+        for (int i = 0; i < 4; i++)
+            graph->add_node([&count]() { count++; });
+        graph->run_and_wait(scheduler);
+        REQUIRE(count == 4);
+    }
+}
+TEST_CASE("task graph runs its nodes inline on a full queue", "[tasks]")
+{
+    using TaskQueue = tasks::threadsafe::Queue<void, 8, 1 << 16>;
+    TaskQueue queue;
+    tasks::Scheduler<TaskQueue> scheduler(queue, 1);
+
+    // hold the only worker, then fill the queue behind it
+    std::atomic<bool> started{false}, release{false};
+    std::atomic<int> filled{0};
+    REQUIRE(queue.try_post([&started, &release]() {
+        started = true;
+        while (!release)
+            std::this_thread::yield();
+    }));
+    while (!started)
+        std::this_thread::yield();
+    int queued = 0;
+    while (queue.try_post_task(queue.make_task([&filled]() { filled++; })))
+        queued++;
+    CHECK(queued > 0);
+
+    // checks only until the worker is released, a failure must not leave it blocked
+    tasks::TaskGraph graph;
+    int a = 0, b = 0;
+    const auto na = graph.add_node([&a]() { a++; });
+    const auto nb = graph.add_node([&a, &b]() { b = a + 1; });
+    graph.add_edge(na, nb);
+    graph.run(scheduler);
+    CHECK(graph.done());
+    graph.wait();
+    CHECK(a == 1);
+    CHECK(b == 2);
+
+    release = true;
+    while (filled < queued)
+        std::this_thread::yield();
+}